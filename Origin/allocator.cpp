@@ -1,9 +1,209 @@
 #include "allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#include <stdlib.h>
+#endif
 
 namespace origin {
+	struct usage {
+		std::atomic<size_t> objects = 0;
+		std::atomic<size_t> bytes = 0;
+	};
+
+	static constexpr size_t max_kinds = 64;
+	static usage usages[max_kinds][memory_phase_count];
+	static std::mutex kinds_mutex;
+	static std::vector<std::string> kind_names;
+	static std::atomic<size_t> reserved = 0;
+	static std::atomic<size_t> peak_reserved = 0;
+	static thread_local memory_phase current_phase = memory_phase::other;
+
+	static const char* phase_names[memory_phase_count] = {
+		"other", "lexing", "parsing", "loading flat trees", "typedef patching", "template instantiation",
+		"body checking",
+	};
+
+	bool allocator::accounting = false;
+
+	memory_phase_scope::memory_phase_scope(memory_phase phase) : previous(current_phase) {
+		current_phase = phase;
+	}
+
+	memory_phase_scope::~memory_phase_scope() {
+		current_phase = previous;
+	}
+
+	// kinds past max_kinds all share the last one
+	size_t allocator::kind(const char* name) {
+		std::lock_guard<std::mutex> lock(kinds_mutex);
+		auto found = std::find(kind_names.begin(), kind_names.end(), name);
+		if (found != kind_names.end()) return (size_t)(found - kind_names.begin());
+		if (kind_names.size() == max_kinds - 1) kind_names.push_back("others");
+		if (kind_names.size() == max_kinds) return max_kinds - 1;
+		kind_names.push_back(name);
+		return kind_names.size() - 1;
+	}
+
+	// names a type the way it's written in the source, without its namespace
+	size_t allocator::register_kind(const std::type_info& type) {
+		std::string name = type.name();
+#ifdef __GNUG__
+		int status;
+		if (char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status)) {
+			name = demangled;
+			free(demangled);
+		}
+#endif
+		for (std::string prefix : { "struct ", "class ", "origin::" }) {
+			if (name.compare(0, prefix.size(), prefix) == 0) name.erase(0, prefix.size());
+		}
+		return kind(name.c_str());
+	}
+
+	void allocator::account(size_t kind, size_t bytes, size_t objects) {
+		usage& entry = usages[kind][(size_t)current_phase];
+		entry.objects.fetch_add(objects, std::memory_order_relaxed);
+		entry.bytes.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	// every phase that used anything, then what each kind took in it, biggest first; bytes are
+	// what objects take in their arenas, not anything they allocate for themselves
+	void allocator::report(std::ostream& out) {
+		std::lock_guard<std::mutex> lock(kinds_mutex);
+		out << "arena chunks: " << peak_reserved << " bytes at peak, " << reserved << " still held" << std::endl;
+		for (size_t phase = 0; phase < memory_phase_count; ++phase) {
+			std::vector<std::pair<size_t, size_t>> kinds;
+			size_t objects = 0, bytes = 0;
+			for (size_t kind = 0; kind < kind_names.size(); ++kind) {
+				usage& entry = usages[kind][phase];
+				if (entry.objects == 0 && entry.bytes == 0) continue;
+				kinds.emplace_back(entry.bytes, kind);
+				objects += entry.objects;
+				bytes += entry.bytes;
+			}
+			if (kinds.empty()) continue;
+			std::sort(kinds.rbegin(), kinds.rend());
+			out << phase_names[phase] << ": " << objects << " objects, " << bytes << " bytes" << std::endl;
+			for (auto& kind : kinds) {
+				out << "  " << kind_names[kind.second] << ": " << usages[kind.second][phase].objects
+					<< " objects, " << kind.first << " bytes" << std::endl;
+			}
+		}
+	}
+
+	static void reserve(size_t bytes) {
+		size_t now = reserved += bytes;
+		size_t peak = peak_reserved;
+		while (now > peak && !peak_reserved.compare_exchange_weak(peak, now)) {
+		}
+	}
+
+	// the smallest spare chunk that holds size bytes, or else a new one of size bytes
+	std::pair<char*, size_t> allocator::take(size_t size) {
+		for (size_t i = spare.size(); i-- > 0;) {
+			if (spare[i].second >= size) {
+				auto chunk = spare[i];
+				spare.erase(spare.begin() + i);
+				chunks.push_back(chunk);
+				return chunk;
+			}
+		}
+		char* chunk = (char*)::operator new(size);
+		chunks.emplace_back(chunk, size);
+		if (accounting) reserve(size);
+		return chunks.back();
+	}
+
+	// starts a new chunk, twice as big as the last up to max_chunk; anything too big to share
+	// one gets a chunk of its own, and the current chunk stays as it was
+	void* allocator::grow(size_t size, size_t align) {
+		size_t needed = size + align;
+		if (needed > max_chunk / 4 && cur != nullptr) {
+			char* chunk = take(needed).first;
+			return (void*)(((uintptr_t)chunk + align - 1) & ~(uintptr_t)(align - 1));
+		}
+		size_t chunk_size = next_chunk;
+		while (chunk_size < needed) chunk_size *= 2;
+		auto chunk = take(chunk_size);
+		if (chunk.second == chunk_size) {
+			next_chunk = chunk_size < max_chunk ? chunk_size * 2 : max_chunk;
+		}
+		cur = chunk.first;
+		end = chunk.first + chunk.second;
+		return bump(size, align);
+	}
+
+	void allocator::run_destructors() {
+		for (destructor* entry = destructors; entry != nullptr;) {
+			destructor* next = entry->next;
+			entry->destroy(entry);
+			entry = next;
+		}
+		destructors = first_destructor = nullptr;
+	}
+
+	// destroys everything allocated so far but keeps the chunks to allocate from again, as many
+	// as the busiest of the last trim_period rounds used, so a steady load stops going to malloc
+	// while a one-off big one is given back after a while
+	void allocator::reset() {
+		run_destructors();
+		size_t used = 0;
+		for (auto& chunk : chunks) {
+			used += chunk.second;
+		}
+		high_water = ++resets % trim_period == 0 ? used : std::max(high_water, used);
+		spare.insert(spare.end(), chunks.begin(), chunks.end());
+		chunks.clear();
+		cur = end = nullptr;
+		count = 0;
+		std::sort(spare.begin(), spare.end(), [](auto& a, auto& b) {
+			return a.second > b.second;
+		});
+		trim(high_water);
+	}
+
+	// frees spare chunks, smallest first, until no more than keep bytes are left
+	void allocator::trim(size_t keep) {
+		size_t kept = 0;
+		for (auto& chunk : spare) {
+			kept += chunk.second;
+		}
+		while (kept > keep) {
+			kept -= spare.back().second;
+			if (accounting) reserved -= spare.back().second;
+			::operator delete(spare.back().first);
+			spare.pop_back();
+		}
+	}
+
+	// takes over everything other holds, to be freed along with this arena's own objects, and
+	// leaves other empty but still usable; several threads can hand their arenas over at once,
+	// as long as none of them allocates from this one meanwhile; an arena adopting itself, as
+	// one lent to a parser is when the parser hands over to it, keeps what it has
+	void allocator::adopt(allocator& other) {
+		if (&other == this) return;
+		std::lock_guard<std::mutex> lock(adopting);
+		chunks.insert(chunks.end(), other.chunks.begin(), other.chunks.end());
+		if (other.destructors != nullptr) {
+			other.first_destructor->next = destructors;
+			destructors = other.destructors;
+			if (first_destructor == nullptr) first_destructor = other.first_destructor;
+		}
+		other.chunks.clear();
+		other.cur = other.end = nullptr;
+		other.destructors = other.first_destructor = nullptr;
+	}
+
 	allocator::~allocator() {
-		for (auto fn : cleanup) {
-			fn();
+		run_destructors();
+		trim(0);
+		for (auto& chunk : chunks) {
+			if (accounting) reserved -= chunk.second;
+			::operator delete(chunk.first);
 		}
 	}
 }
\ No newline at end of file
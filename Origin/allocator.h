@@ -1,19 +1,139 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <vector>
-#include <functional>
 
 namespace origin {
+	// what the compiler is busy with, for telling apart what memory went to
+	enum class memory_phase : unsigned char {
+		other, lex, parse, load, typedefs, templates, bodies,
+	};
+
+	constexpr size_t memory_phase_count = (size_t)memory_phase::bodies + 1;
+
+	// puts what this thread allocates down to a phase until it goes, then back to the last one
+	class memory_phase_scope {
+	private:
+		memory_phase previous;
+	public:
+		explicit memory_phase_scope(memory_phase phase);
+		memory_phase_scope(const memory_phase_scope&) = delete;
+		memory_phase_scope& operator=(const memory_phase_scope&) = delete;
+		~memory_phase_scope();
+	};
+
+	// hands out objects from large chunks by bumping a pointer, and frees them all at once when
+	// it goes; objects that need destroying have an entry placed just before them, linked into a
+	// list that is run in reverse at teardown, and the rest cost nothing beyond their own size;
+	// allocating takes no lock, so each thread works in an arena of its own and hands what it
+	// made over to a longer-lived one with adopt() once it's done, and reset() empties an arena
+	// for another compilation while keeping its memory
 	class allocator {
 	private:
-		std::vector<std::function<void()>> cleanup;
+		struct destructor {
+			void (*destroy)(destructor* entry);
+			destructor* next;
+		};
+
+		static constexpr size_t first_chunk = 4096;
+		static constexpr size_t max_chunk = 1 << 20;
+
+		static constexpr size_t trim_period = 8;
+
+		std::vector<std::pair<char*, size_t>> chunks;
+		// chunks kept from before the last reset, biggest first
+		std::vector<std::pair<char*, size_t>> spare;
+		size_t high_water = 0;
+		size_t resets = 0;
+		char* cur = nullptr;
+		char* end = nullptr;
+		size_t next_chunk = first_chunk;
+		destructor* destructors = nullptr;
+		// the oldest entry, so that another arena's list can be put in front of this one's
+		destructor* first_destructor = nullptr;
+		size_t count = 0;
+		std::mutex adopting;
+
+		std::pair<char*, size_t> take(size_t size);
+		void* grow(size_t size, size_t align);
+		void run_destructors();
+		static size_t register_kind(const std::type_info& type);
+
+		// a number for each type allocated, handed out the first time it's seen
+		template<class T>
+		static size_t kind() {
+			static const size_t result = register_kind(typeid(T));
+			return result;
+		}
+
+		void* bump(size_t size, size_t align) {
+			uintptr_t at = ((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1);
+			if (cur == nullptr || at + size > (uintptr_t)end) return grow(size, align);
+			cur = (char*)(at + size);
+			return (void*)at;
+		}
+
+		// where an object goes after its destructor entry, keeping both aligned
+		template<class T>
+		static constexpr size_t object_offset() {
+			return (sizeof(destructor) + alignof(T) - 1) & ~(alignof(T) - 1);
+		}
+
+		template<class T>
+		static void destroy(destructor* entry) {
+			((T*)((char*)entry + object_offset<T>()))->~T();
+		}
 	public:
+		allocator() {}
+		allocator(const allocator&) = delete;
+		allocator& operator=(const allocator&) = delete;
+
 		template<class T>
 		T* allocate() {
-			T* result = new T();
-			cleanup.push_back([=] {
-				delete result;
-			});
-			return result;
+			static_assert(alignof(T) <= alignof(max_align_t), "over-aligned types aren't supported");
+			count++;
+			if (accounting) account(kind<T>(), footprint<T>());
+			if constexpr (std::is_trivially_destructible_v<T>) {
+				return new (bump(sizeof(T), alignof(T))) T();
+			}
+			else {
+				constexpr size_t align = alignof(T) > alignof(destructor) ? alignof(T) : alignof(destructor);
+				char* memory = (char*)bump(object_offset<T>() + sizeof(T), align);
+				T* result = new (memory + object_offset<T>()) T();
+				destructors = new (memory) destructor{ &destroy<T>, destructors };
+				if (first_destructor == nullptr) first_destructor = destructors;
+				return result;
+			}
+		}
+
+		// the bytes a T takes in the arena, not counting padding
+		template<class T>
+		static constexpr size_t footprint() {
+			return std::is_trivially_destructible_v<T> ? sizeof(T) : object_offset<T>() + sizeof(T);
+		}
+
+		// with accounting on, every arena totals up the objects it hands out, and the chunks it
+		// holds, by type and by phase, for report(); it's set before any arena is used
+		static bool accounting;
+
+		// a number for things counted by hand, which don't come from an arena
+		static size_t kind(const char* name);
+		static void account(size_t kind, size_t bytes, size_t objects = 1);
+		static void report(std::ostream& out);
+
+		void adopt(allocator& other);
+		void reset();
+		void trim(size_t keep = 0);
+
+		// objects allocated from this arena itself, whoever holds them now
+		size_t allocations() const {
+			return count;
 		}
 
 		~allocator();
@@ -3,4 +3,19 @@
 namespace origin {
 	expr::~expr() {}
 	stat::~stat() {}
+
+	block* lambda::body() {
+		if (block == nullptr && read_block) {
+			block = read_block();
+			read_block = nullptr;
+		}
+		return block;
+	}
+
+	void classdef::members() {
+		if (read_members) {
+			read_members();
+			read_members = nullptr;
+		}
+	}
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <string>
 #include <variant>
 #include <unordered_map>
@@ -19,16 +20,15 @@ namespace origin {
 		std::string alias_name;
 		bool alias;
 		std::vector<typing*> templates;
-		token start;
-		token generic_token;
-		token end;
+		source_range range;
+		// where its template types start, or where it does when it has none
+		source_loc generic_loc = no_loc;
 	};
 
 	class expr {
 	public:
 		class typing* typing;
-		token start;
-		token end;
+		source_range range;
 
 		virtual ~expr();
 	};
@@ -36,13 +36,16 @@ namespace origin {
 	class un_expr : public expr {
 	public:
 		std::string op;
+		// the operator's kind, so that what it calls needn't be looked up by its spelling
+		token_kind op_kind = token_kind::none;
 		class expr* expr;
 	};
 
 	class bin_expr : public expr {
 	public:
-		token op_token;
+		source_range op_range;
 		std::string op;
+		token_kind op_kind = token_kind::none;
 		expr* left;
 		expr* right;
 	};
@@ -62,18 +65,18 @@ namespace origin {
 	class member : public expr {
 	public:
 		expr* object;
-		std::string name;
-		token name_token;
+		atom name;
+		source_range name_range;
 	};
 
 	class variable : public expr {
 	public:
-		std::string name;
+		atom name;
 	};
 
 	class int_literal : public expr {
 	public:
-		std::string value;
+		atom value;
 	};
 
 	class parenthetical : public expr {
@@ -86,7 +89,15 @@ namespace origin {
 		class block* block;
 		origin::typing* return_type;
 		std::vector<origin::typing*> param_types;
-		std::vector<std::string> param_names;
+		std::vector<atom> param_names;
+		// set instead of block when the body was skipped over while parsing
+		std::function<class block*()> read_block;
+
+		// the block, read now if it was skipped over; a body a parser skipped is read by that
+		// parser from its lexer's text, so both must outlive the first call, and it's an
+		// assertion failure if the parser doesn't; what it reads goes in the arena the program's
+		// nodes were handed over to, or the parser's own if they weren't
+		class block* body();
 	};
 
 	class error_expr : public expr {
@@ -95,8 +106,7 @@ namespace origin {
 
 	class stat {
 	public:
-		token start;
-		token end;
+		source_range range;
 
 		virtual ~stat();
 	};
@@ -125,12 +135,35 @@ namespace origin {
 
 	class vardecl : public stat {
 	public:
-		token var_token;
-		std::string variable;
+		source_range var_range;
+		atom variable;
 		class typing* typing;
 		expr* init_value;
 	};
 
+	// where a top-level class, function, variable or alias was read from: token positions from
+	// lexer::tell(), up to the furthest token the parser looked at while reading it, the length
+	// and hash of the source from its start to the end of that token, and what reading it
+	// reported, so that a parser can tell whether an edit could have changed it
+	struct declaration {
+		size_t position;
+		size_t end;
+		size_t reach;
+		size_t start;
+		size_t length;
+		uint64_t hash;
+		token reach_token;
+		std::vector<diagnostic> diagnostics;
+		// the location of its start, which its nodes' locations are counted on from however it
+		// moves, and where the parser keeps its place for its lazily read bodies
+		source_loc loc;
+		size_t place;
+		origin::classdef* classdef = nullptr;
+		origin::vardecl* vardecl = nullptr;
+		std::string alias_name;
+		typing* alias = nullptr;
+	};
+
 	class program {
 	public:
 		std::string namespace_name;
@@ -138,19 +171,33 @@ namespace origin {
 		std::vector<vardecl*> vardecls;
 		std::vector<classdef*> classes;
 		std::unordered_map<std::string, typing*> typedefs;
+		// set when the program's declarations were patched and its bodies checked beforehand,
+		// as with a precompiled module; its names are declared, but it isn't checked again
+		bool precompiled = false;
+		// where its file starts among the compilation's locations; read whole, its locations
+		// are that plus their offsets, but not once it's been read again after an edit
+		source_loc base = 0;
+		// in source order; only kept when the parser's lexer can seek
+		std::vector<declaration> declarations;
 	};
 
 	typedef std::vector<program*> compilation_unit;
 
 	class classdef {
 	public:
-		std::string name;
-		token name_token;
+		atom name;
+		source_range name_range;
 		std::vector<vardecl*> vardecls;
 		std::vector<access> accesses;
 		bool is_struct;
 		std::vector<std::string> generics;
 		bool variadic;
 		class program* program;
+		// set while vardecls and accesses are still to be built, as for a class read from a
+		// flat file that nothing has looked up yet
+		std::function<void()> read_members;
+
+		// builds vardecls and accesses now if they were left for later
+		void members();
 	};
 }
\ No newline at end of file
@@ -4,18 +4,26 @@ namespace origin {
 	std::string template_str;
 
 	diagnostic error(const std::string& message, token start) {
-		return { message, start.stream, start.start, start.end, template_str };
+		return { message, range_of(start), template_str };
 	}
 
 	diagnostic error(const std::string& message, token start, token end) {
-		return { message, start.stream, start.start, end.end, template_str };
+		return { message, range_of(start, end), template_str };
 	}
 
 	diagnostic warn(const std::string& message, token start) {
-		return { message, start.stream, start.start, start.end, template_str, true };
+		return { message, range_of(start), template_str, true };
 	}
 
 	diagnostic warn(const std::string& message, token start, token end) {
-		return { message, start.stream, start.start, end.end, template_str, true };
+		return { message, range_of(start, end), template_str, true };
+	}
+
+	diagnostic error(const std::string& message, source_range range) {
+		return { message, range, template_str };
+	}
+
+	diagnostic warn(const std::string& message, source_range range) {
+		return { message, range, template_str, true };
 	}
 }
\ No newline at end of file
@@ -9,4 +9,6 @@ namespace origin {
 	diagnostic error(const std::string& message, token start, token end);
 	diagnostic warn(const std::string& message, token start);
 	diagnostic warn(const std::string& message, token start, token end);
+	diagnostic error(const std::string& message, source_range range);
+	diagnostic warn(const std::string& message, source_range range);
 }
\ No newline at end of file
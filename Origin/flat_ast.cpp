@@ -0,0 +1,602 @@
+#include "flat_ast.h"
+
+namespace origin {
+	std::string_view flat_view::string(string_id id) const {
+		flat_range range = strings[id];
+		return std::string_view(text.data + range.offset, range.count);
+	}
+
+	flat_view flat_tree::view() const {
+		flat_view result;
+		std::apply([&](auto&... views) {
+			std::apply([&](const auto&... pools) {
+				((views = pools), ...);
+			}, pools);
+		}, result.pools);
+		result.ids = ids;
+		result.string_ids = string_ids;
+		result.accesses = accesses;
+		result.typedefs = typedefs;
+		result.text = flat_array<char>(text.data(), text.size());
+		result.strings = strings;
+		result.root = root;
+		return result;
+	}
+
+	size_t flat_tree::nodes() const {
+		size_t result = 0;
+		std::apply([&](const auto&... pools) {
+			((result += pools.size()), ...);
+		}, pools);
+		return result;
+	}
+
+	size_t flat_tree::bytes() const {
+		size_t result = sizeof(flat_tree);
+		std::apply([&](const auto&... pools) {
+			((result += pools.capacity() * sizeof(pools[0])), ...);
+		}, pools);
+		result += ids.capacity() * sizeof(node_id) + string_ids.capacity() * sizeof(string_id)
+			+ accesses.capacity() + typedefs.capacity() * sizeof(flat_typedef)
+			+ text.capacity() + strings.capacity() * sizeof(flat_range);
+		return result;
+	}
+
+	uint32_t flattener::flat(source_loc loc) const {
+		return loc >= base && loc - base < no_file ? loc - base : no_file | loc;
+	}
+
+	flat_span flattener::flat(source_range range) const {
+		return { flat(range.loc), range.length };
+	}
+
+	flattener::flattener(const interner& names, flat_tree& tree) : names(names), tree(tree) {
+	}
+
+	string_id flattener::add_string(std::string_view str) {
+		auto found = strings.find(std::string(str));
+		if (found != strings.end()) {
+			return found->second;
+		}
+		string_id result = (string_id)tree.strings.size();
+		tree.strings.push_back({ (uint32_t)tree.text.size(), (uint32_t)str.size() });
+		tree.text += str;
+		strings.emplace(std::string(str), result);
+		return result;
+	}
+
+	flat_range flattener::add_strings(const std::vector<std::string>& strs) {
+		flat_range result = { (uint32_t)tree.string_ids.size(), (uint32_t)strs.size() };
+		for (const std::string& str : strs) {
+			tree.string_ids.push_back(add_string(str));
+		}
+		return result;
+	}
+
+	// children are walked before their list is added, so that a list is never split by the
+	// lists of its children
+	flat_range flattener::add_ids(const std::vector<node_id>& ids) {
+		flat_range result = { (uint32_t)tree.ids.size(), (uint32_t)ids.size() };
+		tree.ids.insert(tree.ids.end(), ids.begin(), ids.end());
+		return result;
+	}
+
+	template<class T, class U>
+	node_id flattener::add_expr(T& result, U* expr) {
+		result.typing = walk(expr->typing);
+		result.range = flat(expr->range);
+		// a node of its own, plus its destructor entry in the allocator
+		pointer_bytes += allocator::footprint<U>();
+		return tree.add(result);
+	}
+
+	template<class T, class U>
+	node_id flattener::add_stat(T& result, U* stat) {
+		result.range = flat(stat->range);
+		pointer_bytes += allocator::footprint<U>();
+		return tree.add(result);
+	}
+
+	template<class T>
+	void flattener::count(const std::vector<T>& vector) {
+		pointer_bytes += vector.capacity() * sizeof(T);
+	}
+
+	// strings short enough for the small string buffer take nothing more
+	void flattener::count(const std::string& string) {
+		if (string.capacity() > 15) {
+			pointer_bytes += string.capacity() + 1;
+		}
+	}
+
+	void flattener::walk(program* program) {
+		base = program->base;
+		pointer_bytes += allocator::footprint<origin::program>();
+		count(program->namespace_name);
+		tree.root.namespace_name = add_string(program->namespace_name);
+		std::vector<node_id> imports;
+		for (auto s : program->imports) {
+			imports.push_back(walk(s));
+		}
+		count(program->imports);
+		tree.root.imports = add_ids(imports);
+		std::vector<node_id> vardecls;
+		for (auto s : program->vardecls) {
+			vardecls.push_back(walk(s));
+		}
+		count(program->vardecls);
+		tree.root.vardecls = add_ids(vardecls);
+		std::vector<node_id> classes;
+		for (auto s : program->classes) {
+			classes.push_back(walk(s));
+		}
+		count(program->classes);
+		tree.root.classes = add_ids(classes);
+		tree.root.typedefs = { (uint32_t)tree.typedefs.size(), (uint32_t)program->typedefs.size() };
+		for (auto& s : program->typedefs) {
+			// a map node holding the pair, plus a bucket
+			pointer_bytes += sizeof(s) + 2 * sizeof(void*);
+			count(s.first);
+			tree.typedefs.push_back({ add_string(s.first), walk(s.second) });
+		}
+	}
+
+	node_id flattener::walk(classdef* classdef) {
+		classdef->members();
+		flat_classdef result = {};
+		result.name = add_string(names.get(classdef->name));
+		result.name_range = flat(classdef->name_range);
+		std::vector<node_id> vardecls;
+		for (auto s : classdef->vardecls) {
+			vardecls.push_back(walk(s));
+		}
+		result.vardecls = add_ids(vardecls);
+		result.accesses = { (uint32_t)tree.accesses.size(), (uint32_t)classdef->accesses.size() };
+		for (access access : classdef->accesses) {
+			tree.accesses.push_back((unsigned char)access);
+		}
+		result.is_struct = classdef->is_struct;
+		result.generics = add_strings(classdef->generics);
+		result.variadic = classdef->variadic;
+		pointer_bytes += allocator::footprint<origin::classdef>();
+		count(classdef->vardecls);
+		count(classdef->accesses);
+		count(classdef->generics);
+		for (const std::string& generic : classdef->generics) {
+			count(generic);
+		}
+		return tree.add(result);
+	}
+
+	node_id flattener::walk(typing* typing) {
+		if (typing == nullptr) return no_node;
+		auto found = typings.find(typing);
+		if (found != typings.end()) {
+			return found->second;
+		}
+		flat_typing result = {};
+		result.name = add_string(typing->name);
+		result.alias_name = add_string(typing->alias_name);
+		result.alias = typing->alias;
+		std::vector<node_id> templates;
+		for (auto t : typing->templates) {
+			templates.push_back(walk(t));
+		}
+		result.templates = add_ids(templates);
+		result.range = flat(typing->range);
+		result.generic_loc = flat(typing->generic_loc);
+		pointer_bytes += allocator::footprint<origin::typing>();
+		count(typing->name);
+		count(typing->alias_name);
+		count(typing->templates);
+		return typings[typing] = tree.add(result);
+	}
+
+	node_id flattener::walk(vardecl* stat) {
+		flat_vardecl result = {};
+		result.var_range = flat(stat->var_range);
+		result.variable = add_string(names.get(stat->variable));
+		result.typing = walk(stat->typing);
+		result.init_value = stat->init_value != nullptr ? walk_expr(stat->init_value) : no_node;
+		return add_stat(result, stat);
+	}
+
+	node_id flattener::walk(expr_stat* stat) {
+		flat_expr_stat result = {};
+		result.expr = walk_expr(stat->expr);
+		return add_stat(result, stat);
+	}
+
+	node_id flattener::walk(if_stat* stat) {
+		flat_if_stat result = {};
+		result.cond = walk_expr(stat->cond);
+		result.body = walk_stat(stat->body);
+		result.else_body = stat->else_body != nullptr ? walk_stat(stat->else_body) : no_node;
+		return add_stat(result, stat);
+	}
+
+	node_id flattener::walk(block* stat) {
+		flat_block result = {};
+		std::vector<node_id> stats;
+		for (auto s : stat->stats) {
+			stats.push_back(walk_stat(s));
+		}
+		result.stats = add_ids(stats);
+		count(stat->stats);
+		return add_stat(result, stat);
+	}
+
+	node_id flattener::walk(return_stat* stat) {
+		flat_return_stat result = {};
+		result.expr = stat->expr != nullptr ? walk_expr(stat->expr) : no_node;
+		return add_stat(result, stat);
+	}
+
+	node_id flattener::walk(error_expr* expr) {
+		flat_error_expr result = {};
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(lambda* expr) {
+		flat_lambda result = {};
+		result.block = expr->body() != nullptr ? walk(expr->block) : no_node;
+		result.return_type = walk(expr->return_type);
+		std::vector<node_id> param_types;
+		for (auto t : expr->param_types) {
+			param_types.push_back(walk(t));
+		}
+		result.param_types = add_ids(param_types);
+		result.param_names = { (uint32_t)tree.string_ids.size(), (uint32_t)expr->param_names.size() };
+		for (atom name : expr->param_names) {
+			tree.string_ids.push_back(add_string(names.get(name)));
+		}
+		count(expr->param_types);
+		count(expr->param_names);
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(parenthetical* expr) {
+		flat_parenthetical result = {};
+		result.expr = walk_expr(expr->expr);
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(int_literal* expr) {
+		flat_int_literal result = {};
+		result.value = add_string(names.get(expr->value));
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(variable* expr) {
+		flat_variable result = {};
+		result.name = add_string(names.get(expr->name));
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(member* expr) {
+		flat_member result = {};
+		result.object = walk_expr(expr->object);
+		result.name = add_string(names.get(expr->name));
+		result.name_range = flat(expr->name_range);
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(subscript* expr) {
+		flat_subscript result = {};
+		result.left = walk_expr(expr->left);
+		result.right = walk_expr(expr->right);
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(call_expr* expr) {
+		flat_call_expr result = {};
+		result.function = walk_expr(expr->function);
+		std::vector<node_id> args;
+		for (auto s : expr->args) {
+			args.push_back(walk_expr(s));
+		}
+		result.args = add_ids(args);
+		count(expr->args);
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(bin_expr* expr) {
+		flat_bin_expr result = {};
+		result.op_range = flat(expr->op_range);
+		result.op = add_string(expr->op);
+		result.left = walk_expr(expr->left);
+		result.right = walk_expr(expr->right);
+		count(expr->op);
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(un_expr* expr) {
+		flat_un_expr result = {};
+		result.op = add_string(expr->op);
+		result.expr = walk_expr(expr->expr);
+		count(expr->op);
+		return add_expr(result, expr);
+	}
+
+	node_id flattener::walk(compilation_unit* unit) {
+		return no_node;
+	}
+
+	// builds separately allocated nodes back up from a flat_tree, with their ranges put in the
+	// file starting at base; bodies left for later keep the inflater alive, so that typings they share with
+	// the rest of the program are still shared
+	class inflater : public std::enable_shared_from_this<inflater> {
+	private:
+		flat_view tree;
+		allocator& memory;
+		interner& names;
+		source_loc base;
+		bool lazy_bodies;
+		std::vector<atom> atoms;
+		std::unordered_map<node_id, typing*> typings;
+
+		source_loc unflat(uint32_t loc) {
+			return loc & no_file ? loc & ~no_file : make_loc(base, loc);
+		}
+
+		source_range unflat(flat_span span) {
+			return { unflat(span.start), span.length };
+		}
+
+		atom name(string_id id) {
+			if (atoms[id] == 0) {
+				atoms[id] = names.intern(tree.string(id));
+			}
+			return atoms[id];
+		}
+
+		std::string string(string_id id) {
+			return std::string(tree.string(id));
+		}
+
+		template<class T, class U>
+		T* add_expr(const U& node) {
+			T* result = memory.allocate<T>();
+			result->typing = walk_typing(node.typing);
+			result->range = unflat(node.range);
+			return result;
+		}
+
+		template<class T, class U>
+		T* add_stat(const U& node) {
+			T* result = memory.allocate<T>();
+			result->range = unflat(node.range);
+			return result;
+		}
+	public:
+		inflater(const flat_view& tree, allocator& memory, interner& names, source_loc base,
+			bool lazy_bodies) : tree(tree), memory(memory), names(names), base(base),
+			lazy_bodies(lazy_bodies), atoms(tree.strings.size) {
+		}
+
+		typing* walk_typing(node_id id) {
+			if (id == no_node) return nullptr;
+			typing*& result = typings[id];
+			if (result != nullptr) return result;
+			const flat_typing& node = tree.get<flat_typing>(id);
+			result = memory.allocate<typing>();
+			result->name = string(node.name);
+			result->alias_name = string(node.alias_name);
+			result->alias = node.alias;
+			for (const node_id* t = tree.begin(node.templates); t != tree.end(node.templates); ++t) {
+				result->templates.push_back(walk_typing(*t));
+			}
+			result->range = unflat(node.range);
+			result->generic_loc = unflat(node.generic_loc);
+			return result;
+		}
+
+		block* walk_block(node_id id) {
+			const flat_block& node = tree.get<flat_block>(id);
+			auto result = add_stat<block>(node);
+			for (const node_id* s = tree.begin(node.stats); s != tree.end(node.stats); ++s) {
+				result->stats.push_back(walk_stat(*s));
+			}
+			return result;
+		}
+
+		vardecl* walk_vardecl(node_id id) {
+			const flat_vardecl& node = tree.get<flat_vardecl>(id);
+			auto result = add_stat<vardecl>(node);
+			result->var_range = unflat(node.var_range);
+			result->variable = name(node.variable);
+			result->typing = walk_typing(node.typing);
+			result->init_value = node.init_value != no_node ? walk_expr(node.init_value) : nullptr;
+			return result;
+		}
+
+		variable* walk_variable(node_id id) {
+			const flat_variable& node = tree.get<flat_variable>(id);
+			auto result = add_expr<variable>(node);
+			result->name = name(node.name);
+			return result;
+		}
+
+		stat* walk_stat(node_id id) {
+			switch (kind_of(id)) {
+			case node_kind::vardecl:
+				return walk_vardecl(id);
+			case node_kind::expr_stat: {
+				const flat_expr_stat& node = tree.get<flat_expr_stat>(id);
+				auto result = add_stat<expr_stat>(node);
+				result->expr = walk_expr(node.expr);
+				return result;
+			}
+			case node_kind::if_stat: {
+				const flat_if_stat& node = tree.get<flat_if_stat>(id);
+				auto result = add_stat<if_stat>(node);
+				result->cond = walk_expr(node.cond);
+				result->body = walk_stat(node.body);
+				result->else_body = node.else_body != no_node ? walk_stat(node.else_body) : nullptr;
+				return result;
+			}
+			case node_kind::block:
+				return walk_block(id);
+			case node_kind::return_stat: {
+				const flat_return_stat& node = tree.get<flat_return_stat>(id);
+				auto result = add_stat<return_stat>(node);
+				result->expr = node.expr != no_node ? walk_expr(node.expr) : nullptr;
+				return result;
+			}
+			default: {
+				auto result = memory.allocate<expr_stat>();
+				result->expr = walk_expr(id);
+				return result;
+			}
+			}
+		}
+
+		expr* walk_expr(node_id id) {
+			switch (kind_of(id)) {
+			case node_kind::error_expr:
+				return add_expr<error_expr>(tree.get<flat_error_expr>(id));
+			case node_kind::lambda: {
+				const flat_lambda& node = tree.get<flat_lambda>(id);
+				auto result = add_expr<lambda>(node);
+				if (lazy_bodies && node.block != no_node) {
+					result->block = nullptr;
+					result->read_block = [self = shared_from_this(), block = node.block] {
+						memory_phase_scope phase(memory_phase::load);
+						return self->walk_block(block);
+					};
+				}
+				else {
+					result->block = node.block != no_node ? walk_block(node.block) : nullptr;
+				}
+				result->return_type = walk_typing(node.return_type);
+				for (const node_id* t = tree.begin(node.param_types); t != tree.end(node.param_types); ++t) {
+					result->param_types.push_back(walk_typing(*t));
+				}
+				for (uint32_t i = 0; i < node.param_names.count; ++i) {
+					result->param_names.push_back(name(tree.string_ids[node.param_names.offset + i]));
+				}
+				return result;
+			}
+			case node_kind::parenthetical: {
+				const flat_parenthetical& node = tree.get<flat_parenthetical>(id);
+				auto result = add_expr<parenthetical>(node);
+				result->expr = walk_expr(node.expr);
+				return result;
+			}
+			case node_kind::int_literal: {
+				const flat_int_literal& node = tree.get<flat_int_literal>(id);
+				auto result = add_expr<int_literal>(node);
+				result->value = name(node.value);
+				return result;
+			}
+			case node_kind::variable:
+				return walk_variable(id);
+			case node_kind::member: {
+				const flat_member& node = tree.get<flat_member>(id);
+				auto result = add_expr<member>(node);
+				result->object = walk_expr(node.object);
+				result->name = name(node.name);
+				result->name_range = unflat(node.name_range);
+				return result;
+			}
+			case node_kind::subscript: {
+				const flat_subscript& node = tree.get<flat_subscript>(id);
+				auto result = add_expr<subscript>(node);
+				result->left = walk_expr(node.left);
+				result->right = walk_expr(node.right);
+				return result;
+			}
+			case node_kind::call_expr: {
+				const flat_call_expr& node = tree.get<flat_call_expr>(id);
+				auto result = add_expr<call_expr>(node);
+				result->function = walk_expr(node.function);
+				for (const node_id* s = tree.begin(node.args); s != tree.end(node.args); ++s) {
+					result->args.push_back(walk_expr(*s));
+				}
+				return result;
+			}
+			case node_kind::bin_expr: {
+				const flat_bin_expr& node = tree.get<flat_bin_expr>(id);
+				auto result = add_expr<bin_expr>(node);
+				result->op_range = unflat(node.op_range);
+				result->op = string(node.op);
+				result->op_kind = lookup_kind(result->op);
+				result->left = walk_expr(node.left);
+				result->right = walk_expr(node.right);
+				return result;
+			}
+			case node_kind::un_expr: {
+				const flat_un_expr& node = tree.get<flat_un_expr>(id);
+				auto result = add_expr<un_expr>(node);
+				result->op = string(node.op);
+				result->op_kind = lookup_kind(result->op);
+				result->expr = walk_expr(node.expr);
+				return result;
+			}
+			default:
+				// only a damaged file has a node of the wrong kind here, and it's read as an error
+				return memory.allocate<error_expr>();
+			}
+		}
+
+		void walk_members(classdef* result, node_id id) {
+			const flat_classdef& node = tree.get<flat_classdef>(id);
+			for (const node_id* s = tree.begin(node.vardecls); s != tree.end(node.vardecls); ++s) {
+				result->vardecls.push_back(walk_vardecl(*s));
+			}
+			for (uint32_t i = 0; i < node.accesses.count; ++i) {
+				result->accesses.push_back((access)tree.accesses[node.accesses.offset + i]);
+			}
+		}
+
+		classdef* walk_classdef(node_id id) {
+			const flat_classdef& node = tree.get<flat_classdef>(id);
+			auto result = memory.allocate<classdef>();
+			result->name = name(node.name);
+			result->name_range = unflat(node.name_range);
+			if (lazy_bodies) {
+				result->read_members = [self = shared_from_this(), result, id] {
+					memory_phase_scope phase(memory_phase::load);
+					self->walk_members(result, id);
+				};
+			}
+			else {
+				walk_members(result, id);
+			}
+			result->is_struct = node.is_struct;
+			for (uint32_t i = 0; i < node.generics.count; ++i) {
+				result->generics.push_back(string(tree.string_ids[node.generics.offset + i]));
+			}
+			result->variadic = node.variadic;
+			return result;
+		}
+
+		program* walk_program() {
+			auto result = memory.allocate<program>();
+			result->base = base;
+			result->namespace_name = string(tree.root.namespace_name);
+			for (const node_id* s = tree.begin(tree.root.imports); s != tree.end(tree.root.imports); ++s) {
+				result->imports.push_back(walk_variable(*s));
+			}
+			for (const node_id* s = tree.begin(tree.root.vardecls); s != tree.end(tree.root.vardecls); ++s) {
+				result->vardecls.push_back(walk_vardecl(*s));
+			}
+			for (const node_id* s = tree.begin(tree.root.classes); s != tree.end(tree.root.classes); ++s) {
+				result->classes.push_back(walk_classdef(*s));
+			}
+			for (uint32_t i = 0; i < tree.root.typedefs.count; ++i) {
+				const flat_typedef& entry = tree.typedefs[tree.root.typedefs.offset + i];
+				result->typedefs[string(entry.name)] = walk_typing(entry.typing);
+			}
+			return result;
+		}
+	};
+
+	// with lazy_bodies, function bodies are only built once they're walked and the members of
+	// a class once it's looked up, and the arrays the view points to must last until then
+	program* inflate(const flat_view& tree, allocator& memory, interner& names, source_loc base,
+		bool lazy_bodies) {
+		memory_phase_scope phase(memory_phase::load);
+		return std::make_shared<inflater>(tree, memory, names, base, lazy_bodies)->walk_program();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,353 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "allocator.h"
+#include "ast.h"
+#include "interner.h"
+#include "walker.h"
+
+namespace origin {
+	enum class node_kind : unsigned char {
+		none,
+		typing,
+		error_expr, lambda, parenthetical, int_literal, variable, member, subscript, call_expr, bin_expr, un_expr,
+		vardecl, expr_stat, if_stat, block, return_stat,
+		classdef,
+	};
+
+	// a node's kind in the top byte and its index in that kind's pool in the rest,
+	// so that no_node, of kind none, is never a real node
+	typedef uint32_t node_id;
+	constexpr node_id no_node = 0;
+	constexpr size_t max_pool_size = (size_t)1 << 24;
+
+	inline node_kind kind_of(node_id id) {
+		return (node_kind)(id >> 24);
+	}
+
+	inline uint32_t index_of(node_id id) {
+		return id & 0xffffff;
+	}
+
+	// index of a string in a flat_tree's own string table, so that a tree doesn't depend on the
+	// interner it was built with
+	typedef uint32_t string_id;
+
+	// count elements from offset on in one of a flat_tree's shared arrays
+	struct flat_range {
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// a source_range as an offset into its program's file, which is whichever the program is
+	// inflated into; the top bit of start is set for ranges that weren't in the file, such as
+	// ones never set, and the rest of it holds their location as it was
+	struct flat_span {
+		uint32_t start;
+		uint32_t length;
+	};
+
+	constexpr uint32_t no_file = (uint32_t)1 << 31;
+
+	struct flat_typing {
+		static constexpr node_kind kind = node_kind::typing;
+		string_id name;
+		string_id alias_name;
+		bool alias;
+		flat_range templates;
+		flat_span range;
+		// an offset, with no_file set just as in a flat_span
+		uint32_t generic_loc;
+	};
+
+	struct flat_expr {
+		node_id typing;
+		flat_span range;
+	};
+
+	struct flat_error_expr : flat_expr {
+		static constexpr node_kind kind = node_kind::error_expr;
+	};
+
+	struct flat_lambda : flat_expr {
+		static constexpr node_kind kind = node_kind::lambda;
+		node_id block;
+		node_id return_type;
+		flat_range param_types;
+		flat_range param_names;
+	};
+
+	struct flat_parenthetical : flat_expr {
+		static constexpr node_kind kind = node_kind::parenthetical;
+		node_id expr;
+	};
+
+	struct flat_int_literal : flat_expr {
+		static constexpr node_kind kind = node_kind::int_literal;
+		string_id value;
+	};
+
+	struct flat_variable : flat_expr {
+		static constexpr node_kind kind = node_kind::variable;
+		string_id name;
+	};
+
+	struct flat_member : flat_expr {
+		static constexpr node_kind kind = node_kind::member;
+		node_id object;
+		string_id name;
+		flat_span name_range;
+	};
+
+	struct flat_subscript : flat_expr {
+		static constexpr node_kind kind = node_kind::subscript;
+		node_id left;
+		node_id right;
+	};
+
+	struct flat_call_expr : flat_expr {
+		static constexpr node_kind kind = node_kind::call_expr;
+		node_id function;
+		flat_range args;
+	};
+
+	struct flat_bin_expr : flat_expr {
+		static constexpr node_kind kind = node_kind::bin_expr;
+		flat_span op_range;
+		string_id op;
+		node_id left;
+		node_id right;
+	};
+
+	struct flat_un_expr : flat_expr {
+		static constexpr node_kind kind = node_kind::un_expr;
+		string_id op;
+		node_id expr;
+	};
+
+	struct flat_stat {
+		flat_span range;
+	};
+
+	struct flat_vardecl : flat_stat {
+		static constexpr node_kind kind = node_kind::vardecl;
+		flat_span var_range;
+		string_id variable;
+		node_id typing;
+		node_id init_value;
+	};
+
+	struct flat_expr_stat : flat_stat {
+		static constexpr node_kind kind = node_kind::expr_stat;
+		node_id expr;
+	};
+
+	struct flat_if_stat : flat_stat {
+		static constexpr node_kind kind = node_kind::if_stat;
+		node_id cond;
+		node_id body;
+		node_id else_body;
+	};
+
+	struct flat_block : flat_stat {
+		static constexpr node_kind kind = node_kind::block;
+		flat_range stats;
+	};
+
+	struct flat_return_stat : flat_stat {
+		static constexpr node_kind kind = node_kind::return_stat;
+		node_id expr;
+	};
+
+	struct flat_classdef {
+		static constexpr node_kind kind = node_kind::classdef;
+		string_id name;
+		flat_span name_range;
+		flat_range vardecls;
+		flat_range accesses;
+		bool is_struct;
+		flat_range generics;
+		bool variadic;
+	};
+
+	struct flat_typedef {
+		string_id name;
+		node_id typing;
+	};
+
+	// count elements stored one after another, whether in a flat_tree or in a mapped file
+	template<class T>
+	struct flat_array {
+		const T* data = nullptr;
+		size_t size = 0;
+
+		flat_array() {}
+		flat_array(const T* data, size_t size) : data(data), size(size) {}
+		flat_array(const std::vector<T>& vector) : data(vector.data()), size(vector.size()) {}
+
+		const T& operator[](size_t index) const {
+			return data[index];
+		}
+	};
+
+	typedef std::tuple<
+		flat_typing,
+		flat_error_expr, flat_lambda, flat_parenthetical, flat_int_literal, flat_variable, flat_member,
+		flat_subscript, flat_call_expr, flat_bin_expr, flat_un_expr,
+		flat_vardecl, flat_expr_stat, flat_if_stat, flat_block, flat_return_stat,
+		flat_classdef
+	> flat_nodes;
+
+	template<template<class> class C, class Tuple>
+	struct each_node;
+
+	template<template<class> class C, class... T>
+	struct each_node<C, std::tuple<T...>> {
+		typedef std::tuple<C<T>...> type;
+	};
+
+	// where a program is found in a flat_tree or a mapped file
+	struct flat_root {
+		string_id namespace_name;
+		flat_range imports;
+		flat_range vardecls;
+		flat_range classes;
+		flat_range typedefs;
+	};
+
+	// read-only access to a flat program, wherever its arrays are
+	class flat_view {
+	public:
+		each_node<flat_array, flat_nodes>::type pools;
+		flat_array<node_id> ids;
+		flat_array<string_id> string_ids;
+		flat_array<unsigned char> accesses;
+		flat_array<flat_typedef> typedefs;
+		flat_array<char> text;
+		flat_array<flat_range> strings;
+		flat_root root = {};
+
+		template<class T>
+		const flat_array<T>& pool() const {
+			return std::get<flat_array<T>>(pools);
+		}
+
+		template<class T>
+		const T& get(node_id id) const {
+			return pool<T>()[index_of(id)];
+		}
+
+		const node_id* begin(flat_range range) const {
+			return ids.data + range.offset;
+		}
+
+		const node_id* end(flat_range range) const {
+			return ids.data + range.offset + range.count;
+		}
+
+		std::string_view string(string_id id) const;
+	};
+
+	// a program stored as plain structs in a pool per kind of node; children are node_ids and
+	// lists of them are ranges into one shared array, so a whole tree is a few dozen allocations
+	class flat_tree {
+	public:
+		each_node<std::vector, flat_nodes>::type pools;
+		std::vector<node_id> ids;
+		std::vector<string_id> string_ids;
+		std::vector<unsigned char> accesses;
+		std::vector<flat_typedef> typedefs;
+		// the text of every string, one after another
+		std::string text;
+		std::vector<flat_range> strings;
+		flat_root root = {};
+		// set once a pool has run out of indices; what's added after that is left out, so
+		// the tree is incomplete and is only good for falling back to the parsed program
+		bool full = false;
+
+		template<class T>
+		std::vector<T>& pool() {
+			return std::get<std::vector<T>>(pools);
+		}
+
+		template<class T>
+		node_id add(const T& node);
+
+		flat_view view() const;
+		size_t nodes() const;
+		size_t bytes() const;
+	};
+
+	template<class T>
+	node_id flat_tree::add(const T& node) {
+		std::vector<T>& nodes = pool<T>();
+		if (nodes.size() >= max_pool_size) {
+			full = true;
+			return no_node;
+		}
+		nodes.push_back(node);
+		return ((node_id)T::kind << 24) | (node_id)(nodes.size() - 1);
+	}
+
+	// copies a parsed program into a flat_tree, parsing any bodies that were skipped; also
+	// totals up what the program takes as separately allocated nodes, for comparison
+	class flattener : public walker<node_id> {
+	private:
+		const interner& names;
+		flat_tree& tree;
+		std::unordered_map<std::string, string_id> strings;
+		// a typing can be shared by several nodes, and patching it patches it for all of them
+		std::unordered_map<typing*, node_id> typings;
+		// where the program's file starts, which its ranges are kept relative to
+		source_loc base = 0;
+
+		uint32_t flat(source_loc loc) const;
+		flat_span flat(source_range range) const;
+		string_id add_string(std::string_view str);
+		flat_range add_strings(const std::vector<std::string>& strs);
+		flat_range add_ids(const std::vector<node_id>& ids);
+		template<class T, class U>
+		node_id add_expr(T& result, U* expr);
+		template<class T, class U>
+		node_id add_stat(T& result, U* stat);
+		template<class T>
+		void count(const std::vector<T>& vector);
+		void count(const std::string& string);
+	public:
+		size_t pointer_bytes = 0;
+
+		flattener(const interner& names, flat_tree& tree);
+
+		void walk(program* program);
+		node_id walk(classdef* classdef);
+		node_id walk(typing* typing);
+
+		virtual node_id walk(vardecl* stat);
+		virtual node_id walk(expr_stat* stat);
+		virtual node_id walk(if_stat* stat);
+		virtual node_id walk(block* stat);
+		virtual node_id walk(return_stat* stat);
+
+		virtual node_id walk(error_expr* expr);
+		virtual node_id walk(lambda* expr);
+		virtual node_id walk(parenthetical* expr);
+		virtual node_id walk(int_literal* expr);
+		virtual node_id walk(variable* expr);
+		virtual node_id walk(member* expr);
+		virtual node_id walk(subscript* expr);
+		virtual node_id walk(call_expr* expr);
+		virtual node_id walk(bin_expr* expr);
+		virtual node_id walk(un_expr* expr);
+
+		virtual node_id walk(compilation_unit* unit);
+	};
+
+	program* inflate(const flat_view& tree, allocator& memory, interner& names, source_loc base,
+		bool lazy_bodies = false);
+}
\ No newline at end of file
@@ -0,0 +1,357 @@
+#include "flat_file.h"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace origin {
+	static const char flat_magic[8] = { 'o', 'r', 'i', 'g', 'i', 'n', 'f', 't' };
+	static constexpr uint32_t byte_order = 0x01020304;
+
+	// where one of a flat_view's arrays is, as an offset from the start of the file
+	struct flat_section {
+		uint64_t offset;
+		uint64_t count;
+		uint32_t element_size;
+		uint32_t reserved;
+	};
+
+	static constexpr size_t section_count = std::tuple_size<flat_nodes>::value + 6;
+
+	// the file starts with this, followed by the sections it points to, each 8-byte aligned;
+	// a file from another version, or from a build with different byte order or node layout,
+	// is never read
+	struct flat_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t flags;
+		uint32_t reserved;
+		uint64_t source_size;
+		uint64_t source_hash;
+		flat_root root;
+		flat_section sections[section_count];
+	};
+
+	// calls f on each of the view's arrays, always in the same order
+	template<class F>
+	static void each_array(flat_view& view, F f) {
+		std::apply([&](auto&... pools) {
+			(f(pools), ...);
+		}, view.pools);
+		f(view.ids);
+		f(view.string_ids);
+		f(view.accesses);
+		f(view.typedefs);
+		f(view.text);
+		f(view.strings);
+	}
+
+	// the file is written beside path and then renamed over it, so that a reader never sees
+	// it half written
+	bool write_flat_file(const std::string& path, const flat_tree& tree, std::string_view source,
+		uint32_t flags) {
+		flat_view view = tree.view();
+		flat_header header = {};
+		memcpy(header.magic, flat_magic, sizeof(flat_magic));
+		header.version = flat_file_version;
+		header.byte_order = byte_order;
+		header.flags = flags;
+		header.source_size = source.size();
+		header.source_hash = hash_source(source);
+		header.root = view.root;
+		std::string contents(sizeof(flat_header), '\0');
+		size_t section = 0;
+		each_array(view, [&](auto& array) {
+			size_t element_size = sizeof(array.data[0]);
+			contents.resize((contents.size() + 7) & ~(size_t)7);
+			header.sections[section++] = { contents.size(), array.size, (uint32_t)element_size, 0 };
+			contents.append((const char*)array.data, array.size * element_size);
+		});
+		memcpy(&contents[0], &header, sizeof(flat_header));
+
+		std::string temp = path + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			if (!out.write(contents.data(), contents.size())) return false;
+		}
+		if (rename(temp.c_str(), path.c_str()) != 0) {
+			remove(path.c_str());
+			if (rename(temp.c_str(), path.c_str()) != 0) {
+				remove(temp.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	mapped_flat_file::mapped_flat_file(const std::string& path, std::string_view source, uint32_t flags) {
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			file = nullptr;
+			return;
+		}
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) return;
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr) return;
+		size = (size_t)file_size.QuadPart;
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) return;
+		struct ::stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapped != MAP_FAILED) {
+				data = (const char*)mapped;
+				size = (size_t)info.st_size;
+			}
+		}
+		close(fd);
+		if (data == nullptr) return;
+#endif
+		load(source, flags);
+	}
+
+	// walks a view's tree from its root as the inflater would, checking that every node_id,
+	// string_id and range points inside its arrays, that each child is of a kind the inflater
+	// can take where it's found, and that no node is its own descendant, so that a damaged file
+	// is never inflated
+	class flat_checker {
+	private:
+		enum : unsigned char { unseen, checking, checked };
+
+		const flat_view& view;
+		std::vector<unsigned char> states[(size_t)node_kind::classdef + 1];
+
+		bool fits(flat_range range, size_t size) const {
+			return range.offset <= size && range.count <= size - range.offset;
+		}
+
+		bool is_string(string_id id) const {
+			return id < view.strings.size;
+		}
+
+		bool all_strings(flat_range range) const {
+			if (!fits(range, view.string_ids.size)) return false;
+			for (uint32_t i = 0; i < range.count; ++i) {
+				if (!is_string(view.string_ids[range.offset + i])) return false;
+			}
+			return true;
+		}
+
+		template<class F>
+		bool all_ids(flat_range range, F f) {
+			if (!fits(range, view.ids.size)) return false;
+			for (uint32_t i = 0; i < range.count; ++i) {
+				if (!f(view.ids[range.offset + i])) return false;
+			}
+			return true;
+		}
+
+		// a node that's reached again while it's still being checked is in a cycle, which the
+		// inflater would never come out of
+		template<class T>
+		bool node(node_id id) {
+			if (kind_of(id) != T::kind || index_of(id) >= view.pool<T>().size) return false;
+			unsigned char& state = states[(size_t)T::kind][index_of(id)];
+			if (state != unseen) return state == checked;
+			state = checking;
+			if (!check(view.get<T>(id))) return false;
+			state = checked;
+			return true;
+		}
+
+		bool typing(node_id id) {
+			return id == no_node || node<flat_typing>(id);
+		}
+
+		bool expr(node_id id) {
+			switch (kind_of(id)) {
+			case node_kind::error_expr: return node<flat_error_expr>(id);
+			case node_kind::lambda: return node<flat_lambda>(id);
+			case node_kind::parenthetical: return node<flat_parenthetical>(id);
+			case node_kind::int_literal: return node<flat_int_literal>(id);
+			case node_kind::variable: return node<flat_variable>(id);
+			case node_kind::member: return node<flat_member>(id);
+			case node_kind::subscript: return node<flat_subscript>(id);
+			case node_kind::call_expr: return node<flat_call_expr>(id);
+			case node_kind::bin_expr: return node<flat_bin_expr>(id);
+			case node_kind::un_expr: return node<flat_un_expr>(id);
+			default: return false;
+			}
+		}
+
+		bool stat(node_id id) {
+			switch (kind_of(id)) {
+			case node_kind::vardecl: return node<flat_vardecl>(id);
+			case node_kind::expr_stat: return node<flat_expr_stat>(id);
+			case node_kind::if_stat: return node<flat_if_stat>(id);
+			case node_kind::block: return node<flat_block>(id);
+			case node_kind::return_stat: return node<flat_return_stat>(id);
+			default: return false;
+			}
+		}
+
+		bool check(const flat_typing& node) {
+			return is_string(node.name) && is_string(node.alias_name)
+				&& all_ids(node.templates, [&](node_id t) { return typing(t); });
+		}
+
+		bool check(const flat_error_expr& node) {
+			return typing(node.typing);
+		}
+
+		bool check(const flat_lambda& node) {
+			return typing(node.typing) && (node.block == no_node || this->node<flat_block>(node.block))
+				&& typing(node.return_type) && all_strings(node.param_names)
+				&& all_ids(node.param_types, [&](node_id t) { return typing(t); });
+		}
+
+		bool check(const flat_parenthetical& node) {
+			return typing(node.typing) && expr(node.expr);
+		}
+
+		bool check(const flat_int_literal& node) {
+			return typing(node.typing) && is_string(node.value);
+		}
+
+		bool check(const flat_variable& node) {
+			return typing(node.typing) && is_string(node.name);
+		}
+
+		bool check(const flat_member& node) {
+			return typing(node.typing) && expr(node.object) && is_string(node.name);
+		}
+
+		bool check(const flat_subscript& node) {
+			return typing(node.typing) && expr(node.left) && expr(node.right);
+		}
+
+		bool check(const flat_call_expr& node) {
+			return typing(node.typing) && expr(node.function)
+				&& all_ids(node.args, [&](node_id e) { return expr(e); });
+		}
+
+		bool check(const flat_bin_expr& node) {
+			return typing(node.typing) && is_string(node.op) && expr(node.left) && expr(node.right);
+		}
+
+		bool check(const flat_un_expr& node) {
+			return typing(node.typing) && is_string(node.op) && expr(node.expr);
+		}
+
+		bool check(const flat_vardecl& node) {
+			return is_string(node.variable) && typing(node.typing)
+				&& (node.init_value == no_node || expr(node.init_value));
+		}
+
+		bool check(const flat_expr_stat& node) {
+			return expr(node.expr);
+		}
+
+		bool check(const flat_if_stat& node) {
+			return expr(node.cond) && stat(node.body) && (node.else_body == no_node || stat(node.else_body));
+		}
+
+		bool check(const flat_block& node) {
+			return all_ids(node.stats, [&](node_id s) { return stat(s); });
+		}
+
+		bool check(const flat_return_stat& node) {
+			return node.expr == no_node || expr(node.expr);
+		}
+
+		bool check(const flat_classdef& node) {
+			if (!is_string(node.name) || !all_strings(node.generics)
+				|| node.accesses.count != node.vardecls.count || !fits(node.accesses, view.accesses.size)) {
+				return false;
+			}
+			for (uint32_t i = 0; i < node.accesses.count; ++i) {
+				if (view.accesses[node.accesses.offset + i] > public_access) return false;
+			}
+			return all_ids(node.vardecls, [&](node_id s) { return this->node<flat_vardecl>(s); });
+		}
+	public:
+		flat_checker(const flat_view& view) : view(view) {
+			std::apply([&](const auto&... pools) {
+				((states[(size_t)std::decay_t<decltype(pools[0])>::kind].resize(pools.size)), ...);
+			}, view.pools);
+		}
+
+		bool sound() {
+			for (size_t i = 0; i < view.strings.size; ++i) {
+				if (!fits(view.strings[i], view.text.size)) return false;
+			}
+			const flat_root& root = view.root;
+			if (!is_string(root.namespace_name) || !fits(root.typedefs, view.typedefs.size)) return false;
+			for (uint32_t i = 0; i < root.typedefs.count; ++i) {
+				const flat_typedef& entry = view.typedefs[root.typedefs.offset + i];
+				if (!is_string(entry.name) || !typing(entry.typing)) return false;
+			}
+			return all_ids(root.imports, [&](node_id e) { return node<flat_variable>(e); })
+				&& all_ids(root.vardecls, [&](node_id s) { return node<flat_vardecl>(s); })
+				&& all_ids(root.classes, [&](node_id c) { return node<flat_classdef>(c); });
+		}
+	};
+
+	// the header is checked against the source, the sections against the file's size and every
+	// node against the sections, and a file that fails any of it is treated as missing
+	void mapped_flat_file::load(std::string_view source, uint32_t flags) {
+		if (size < sizeof(flat_header)) return;
+		flat_header header;
+		memcpy(&header, data, sizeof(flat_header));
+		if (memcmp(header.magic, flat_magic, sizeof(flat_magic)) != 0
+			|| header.version != flat_file_version || header.byte_order != byte_order || header.flags != flags
+			|| header.source_size != source.size() || header.source_hash != hash_source(source)) {
+			return;
+		}
+		bool fits = true;
+		size_t section = 0;
+		each_array(contents, [&](auto& array) {
+			typedef std::remove_const_t<std::remove_reference_t<decltype(array.data[0])>> element;
+			const flat_section& entry = header.sections[section++];
+			if (entry.element_size != sizeof(element) || entry.offset % alignof(element) != 0
+				|| entry.offset > size || entry.count > (size - entry.offset) / sizeof(element)) {
+				fits = false;
+				return;
+			}
+			array = flat_array<element>((const element*)(data + entry.offset), (size_t)entry.count);
+		});
+		contents.root = header.root;
+		loaded = fits && flat_checker(contents).sound();
+	}
+
+	mapped_flat_file::~mapped_flat_file() {
+#ifdef _WIN32
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != nullptr) CloseHandle(file);
+#else
+		if (data != nullptr) munmap((void*)data, size);
+#endif
+	}
+
+	bool mapped_flat_file::valid() const {
+		return loaded;
+	}
+
+	const flat_view& mapped_flat_file::view() const {
+		return contents;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include "flat_ast.h"
+
+namespace origin {
+	// bumped whenever the layout of a flat file, or of any flat node, changes
+	constexpr uint32_t flat_file_version = 3;
+
+	// set on a file whose program had its declarations patched before it was written
+	constexpr uint32_t flat_patched = 1;
+
+	bool write_flat_file(const std::string& path, const flat_tree& tree, std::string_view source,
+		uint32_t flags = 0);
+
+	// a flat file mapped into memory and read in place; node_ids and ranges are offsets within
+	// the file already, so nothing is deserialized, and the view is good for as long as this is
+	class mapped_flat_file {
+	private:
+		const char* data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		void* file = nullptr;
+		void* mapping = nullptr;
+#endif
+		flat_view contents;
+		bool loaded = false;
+
+		void load(std::string_view source, uint32_t flags);
+	public:
+		mapped_flat_file(const std::string& path, std::string_view source, uint32_t flags = 0);
+		mapped_flat_file(const mapped_flat_file&) = delete;
+		mapped_flat_file& operator=(const mapped_flat_file&) = delete;
+		~mapped_flat_file();
+
+		bool valid() const;
+		const flat_view& view() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "interner.h"
+#include "lexer.h"
+
+namespace origin {
+	interner::interner() {
+		for (size_t i = 0; i <= (size_t)token_kind::close_brace; ++i) {
+			intern(spelling((token_kind)i));
+		}
+	}
+
+	size_t interner::block_of(atom atom, size_t& offset) {
+		size_t block = 0;
+		for (size_t n = atom / first_block + 1; n > 1; n >>= 1) {
+			++block;
+		}
+		offset = atom - first_block * (((size_t)1 << block) - 1);
+		return block;
+	}
+
+	atom interner::intern(std::string_view str) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = atoms.find(str);
+		if (found != atoms.end()) {
+			return found->second;
+		}
+		atom result = (atom)count++;
+		size_t offset;
+		size_t block = block_of(result, offset);
+		if (offset == 0) {
+			blocks[block].reset(new std::string[first_block << block]);
+		}
+		std::string& stored = blocks[block][offset];
+		stored = str;
+		atoms.emplace(std::string_view(stored), result);
+		return result;
+	}
+
+	const std::string& interner::get(atom atom) const {
+		size_t offset;
+		size_t block = block_of(atom, offset);
+		return blocks[block][offset];
+	}
+
+	size_t interner::size() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return count;
+	}
+}
\ No newline at end of file
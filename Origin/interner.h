@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace origin {
+	// index of an interned string; atoms compare equal exactly when their strings do
+	typedef uint32_t atom;
+
+	// maps every identifier, number and symbol spelling in a compilation to an atom;
+	// keyword and symbol spellings are interned up front, so their atom is their token_kind;
+	// intern() may be called from several threads at once, and get() never waits on it
+	class interner {
+	private:
+		// block b holds the first_block << b strings after those in earlier blocks; strings never
+		// move once interned, so get() can read them without locking
+		static constexpr size_t first_block = 256;
+		std::unique_ptr<std::string[]> blocks[24];
+		size_t count = 0;
+		std::unordered_map<std::string_view, atom> atoms;
+		mutable std::mutex mutex;
+
+		static size_t block_of(atom atom, size_t& offset);
+	public:
+		interner();
+		interner(const interner&) = delete;
+		interner& operator=(const interner&) = delete;
+
+		atom intern(std::string_view str);
+		const std::string& get(atom atom) const;
+		size_t size() const;
+	};
+}
\ No newline at end of file
@@ -1,21 +1,37 @@
 #include "lexer.h"
+#include <stdint.h>
+#include <string.h>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <thread>
 #include <unordered_map>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace std::string_literals;
 
 namespace origin {
-	constexpr const char* keywords[] = {
+	// spelling of every token_kind, in the order they're declared; symbols are
+	// ordered so that no symbol comes after one of its own prefixes
+	constexpr const char* spellings[] = {
+		"",
+
 		"if", "else", "true", "false",
 		"return", "do",
 		"namespace", "import",
 		"class", "struct", "public", "private",
 		"operator",
 		"alias",
-		nullptr
-	};
 
-	constexpr const char* symbols[] = {
 		"<<~=", "~>>=",
 
 		"<=>", "...", "<<~", "~>>",
@@ -25,77 +41,414 @@ namespace origin {
 		"==", "!=",
 		
 		".", "[", "]", "(", ")", "~", "!", "-", "+", "*", "/",
-		"%", "+", "-", "<", ">", "&", "^", "|", "?", ":", "=", ",",
+		"%", "<", ">", "&", "^", "|", "?", ":", "=", ",",
 
 		";", "{", "}",
-		nullptr
 	};
 
-	static bool next_is(std::istream& stream, std::string value) {
-		std::streampos pos = stream.tellg();
-		stream.seekg(0, std::ios_base::end);
-		std::streampos size = stream.tellg();
-		stream.seekg(pos);
-		if (size - pos < (std::streampos)value.length()) return false;
-		for (char c : value) {
-			if (stream.get() != c) {
-				stream.seekg(pos);
-				return false;
+	constexpr size_t kind_count = sizeof(spellings) / sizeof(*spellings);
+	static_assert(kind_count == token_kind_count, "spellings[] is out of sync with token_kind");
+
+	constexpr size_t first_symbol = (size_t)token_kind::shl_assign;
+
+	static constexpr bool is_keyword(token_kind kind) {
+		return kind >= token_kind::if_keyword && kind <= token_kind::alias_keyword;
+	}
+
+	static constexpr const char* end_of(const char* str) {
+		while (*str != 0) str++;
+		return str;
+	}
+
+	// perfect hash over spellings[]; the seed is searched for at compile time
+	constexpr size_t kind_table_size = 512;
+
+	struct kind_table {
+		uint32_t seed = 0;
+		token_kind kinds[kind_table_size] = {};
+	};
+
+	static constexpr size_t hash_spelling(const char* begin, const char* end, uint32_t seed) {
+		uint32_t hash = seed;
+		for (const char* c = begin; c != end; ++c) {
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+		}
+		return hash % kind_table_size;
+	}
+
+	static constexpr kind_table build_kind_table() {
+		kind_table table;
+		for (uint32_t seed = 2166136261u; ; ++seed) {
+			bool collision = false;
+			for (size_t i = 0; i < kind_table_size; ++i) {
+				table.kinds[i] = token_kind::none;
+			}
+			for (size_t i = 1; i < kind_count && !collision; ++i) {
+				size_t hash = hash_spelling(spellings[i], end_of(spellings[i]), seed);
+				collision = table.kinds[hash] != token_kind::none;
+				table.kinds[hash] = (token_kind)i;
+			}
+			if (!collision) {
+				table.seed = seed;
+				return table;
+			}
+		}
+	}
+
+	static constexpr kind_table kind_hash = build_kind_table();
+
+	static token_kind lookup_kind(const char* begin, const char* end) {
+		token_kind kind = kind_hash.kinds[hash_spelling(begin, end, kind_hash.seed)];
+		const char* expected = spellings[(size_t)kind];
+		for (const char* c = begin; c != end; ++c, ++expected) {
+			if (*expected != *c) return token_kind::none;
+		}
+		return *expected == 0 ? kind : token_kind::none;
+	}
+
+	// longest-match automaton over the symbols in spellings[], built at compile time;
+	// state 0 is the start state, and a transition to 0 means there is nothing left to match
+	struct symbol_dfa {
+		static constexpr size_t max_states = 64;
+		unsigned char next[max_states][128] = {};
+		token_kind accept[max_states] = {};
+		size_t states = 1;
+	};
+
+	static constexpr symbol_dfa build_symbol_dfa() {
+		symbol_dfa dfa;
+		for (size_t i = first_symbol; i < kind_count; ++i) {
+			size_t state = 0;
+			for (const char* c = spellings[i]; *c != 0; ++c) {
+				if (dfa.next[state][(unsigned char)*c] == 0) {
+					dfa.next[state][(unsigned char)*c] = (unsigned char)dfa.states++;
+				}
+				state = dfa.next[state][(unsigned char)*c];
 			}
+			dfa.accept[state] = (token_kind)i;
+		}
+		return dfa;
+	}
+
+	static constexpr symbol_dfa symbol_table = build_symbol_dfa();
+
+	// returns the longest symbol at cur, or token_kind::none
+	static constexpr token_kind match_symbol(const char* cur, const char* end, const char*& match_end) {
+		token_kind result = token_kind::none;
+		size_t state = 0;
+		for (const char* c = cur; c != end && (unsigned char)*c < 128; ++c) {
+			state = symbol_table.next[state][(unsigned char)*c];
+			if (state == 0) break;
+			if (symbol_table.accept[state] != token_kind::none) {
+				result = symbol_table.accept[state];
+				match_end = c + 1;
+			}
+		}
+		return result;
+	}
+
+	// the automaton must agree with scanning the symbols in order and taking the
+	// first one that is a prefix of the input, which is how symbols used to be matched
+	static constexpr bool next_is(const char* cur, const char* end, const char* value) {
+		for (; *value != 0; cur++, value++) {
+			if (cur == end || *cur != *value) return false;
 		}
 		return true;
 	}
 
-	token lexer::next_internal() {
-		return next_internal(false, {});
-	}
-
-	token lexer::next_internal(bool local_ln, token local_ln_token) {
-		int ws_char = input.peek();
-		while (ws_char == ' ' || ws_char == '\t' || ws_char == '\n'
-			|| ws_char == '\r') {
-			if (ws_char == '\n') {
-				size_t ln = (size_t)input.tellg();
-				if (!local_ln) {
-					local_ln = true;
-					local_ln_token = { token_type::invalid_token, &input, "\n", ln, ln };
+	static constexpr bool symbol_table_agrees(const char* cur, const char* end) {
+		token_kind expected = token_kind::none;
+		for (size_t i = first_symbol; i < kind_count; ++i) {
+			if (next_is(cur, end, spellings[i])) {
+				expected = (token_kind)i;
+				break;
+			}
+		}
+		const char* match_end = cur;
+		return match_symbol(cur, end, match_end) == expected;
+	}
+
+	static constexpr bool symbol_table_agrees() {
+		for (size_t i = first_symbol; i < kind_count; ++i) {
+			for (size_t j = first_symbol; j < kind_count; ++j) {
+				char input[9] = {};
+				size_t length = 0;
+				for (const char* c = spellings[i]; *c != 0; ++c) input[length++] = *c;
+				for (const char* c = spellings[j]; *c != 0; ++c) input[length++] = *c;
+				for (size_t k = 0; k < length; ++k) {
+					if (!symbol_table_agrees(input + k, input + length)) return false;
 				}
 			}
-			input.get();
-			ws_char = input.peek();
 		}
-		has_ln = local_ln;
-		ln_token = local_ln_token;
-		if (input.eof()) {
-			input.seekg(0, std::ios_base::end);
-			size_t index = (size_t)input.tellg();
-			return { token_type::eof, &input, "", index, index };
+		return true;
+	}
+
+	static_assert(symbol_table_agrees(), "symbol automaton disagrees with spellings[]");
+
+	// how far past the end of a token the lexer may have looked to decide where it ends
+	static constexpr size_t longest_symbol() {
+		size_t longest = 0;
+		for (size_t i = first_symbol; i < kind_count; ++i) {
+			longest = std::max(longest, (size_t)(end_of(spellings[i]) - spellings[i]));
 		}
-		if (input.get() == '/' && input.peek() == '/') {
-			std::string _;
-			getline(input, _);
-			return next_internal(local_ln, local_ln_token);
+		return longest;
+	}
+
+	// whitespace and comments are skipped a vector at a time where the target allows it
+#if defined(__AVX2__)
+	typedef __m256i chunk;
+	constexpr size_t chunk_size = 32;
+
+	static inline chunk load_chunk(const char* at) {
+		return _mm256_loadu_si256((const __m256i*)at);
+	}
+
+	static inline uint32_t match_chunk(chunk data, char c) {
+		return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, _mm256_set1_epi8(c)));
+	}
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ORIGIN_SSE2
+	typedef __m128i chunk;
+	constexpr size_t chunk_size = 16;
+
+	static inline chunk load_chunk(const char* at) {
+		return _mm_loadu_si128((const __m128i*)at);
+	}
+
+	static inline uint32_t match_chunk(chunk data, char c) {
+		return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(data, _mm_set1_epi8(c)));
+	}
+#endif
+
+#if defined(__AVX2__) || defined(ORIGIN_SSE2)
+#define ORIGIN_SIMD
+	constexpr uint32_t chunk_mask = (uint32_t)((1ull << chunk_size) - 1);
+
+	static inline size_t first_bit(uint32_t mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return (size_t)__builtin_ctz(mask);
+#endif
+	}
+#endif
+
+	static inline bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	// skip_whitespace a character at a time, as it finishes what's left after its last chunk
+	static const char* skip_whitespace_plain(const char* cur, const char* end, const char*& newline) {
+		for (; cur != end && is_space(*cur); ++cur) {
+			if (*cur == '\n' && newline == nullptr) {
+				newline = cur;
+			}
 		}
-		else {
-			input.unget();
-			if (input.get() == '/' && input.peek() == '*') {
-				input.get();
-				while (!input.eof() && !(input.get() == '*' && input.peek() == '/'));
-				input.get();
-				return next_internal(local_ln, local_ln_token);
+		return cur;
+	}
+
+	// returns the first character at or after cur that isn't whitespace; if newline is
+	// still null, it's set to the first '\n' that was skipped
+	static const char* skip_whitespace(const char* cur, const char* end, const char*& newline) {
+		if (cur == end || !is_space(*cur)) return cur;
+#ifdef ORIGIN_SIMD
+		while ((size_t)(end - cur) >= chunk_size) {
+			chunk data = load_chunk(cur);
+			uint32_t lf = match_chunk(data, '\n');
+			uint32_t space = match_chunk(data, ' ') | match_chunk(data, '\t')
+				| match_chunk(data, '\r') | lf;
+			uint32_t stop = ~space & chunk_mask;
+			if (stop != 0) {
+				lf &= (1u << first_bit(stop)) - 1;
 			}
-			else {
-				input.unget();
+			if (lf != 0 && newline == nullptr) {
+				newline = cur + first_bit(lf);
 			}
+			if (stop != 0) {
+				return cur + first_bit(stop);
+			}
+			cur += chunk_size;
 		}
-		char c = input.peek();
-		auto read_while = [this](bool cond(char c)) {
-			std::ostringstream res;
-			while (!input.eof() && cond(input.peek())) {
-				res << (char)input.get();
+#endif
+		return skip_whitespace_plain(cur, end, newline);
+	}
+
+	// returns the character after the next '\n', or end
+	static const char* skip_line(const char* cur, const char* end) {
+#ifdef ORIGIN_SIMD
+		while ((size_t)(end - cur) >= chunk_size) {
+			uint32_t lf = match_chunk(load_chunk(cur), '\n');
+			if (lf != 0) {
+				return cur + first_bit(lf) + 1;
 			}
-			return res.str();
-		};
+			cur += chunk_size;
+		}
+#endif
+		while (cur != end && *cur++ != '\n');
+		return cur;
+	}
+
+	// skip_block_comment a character at a time
+	static const char* skip_block_comment_plain(const char* cur, const char* end) {
+		while (cur != end && !(*cur++ == '*' && cur != end && *cur == '/'));
+		if (cur != end) cur++;
+		return cur;
+	}
+
+	// returns the character after the next "*/", or end
+	static const char* skip_block_comment(const char* cur, const char* end) {
+#ifdef ORIGIN_SIMD
+		while ((size_t)(end - cur) > chunk_size) {
+			uint32_t close = match_chunk(load_chunk(cur), '*') & match_chunk(load_chunk(cur + 1), '/');
+			if (close != 0) {
+				return cur + first_bit(close) + 2;
+			}
+			cur += chunk_size;
+		}
+#endif
+		return skip_block_comment_plain(cur, end);
+	}
+
+	token lexer::lex() {
+		size_t from = offset_of(cur);
+		token result = next_internal();
+		size_t to = offset_of(cur);
+		if (from < scanned) {
+			relexed_chars += std::min(to, scanned) - from;
+		}
+		scanned = std::max(scanned, to);
+		index_lines(to);
+		return result;
+	}
+
+	// records the start of every line that begins at or before the given offset
+	void lexer::index_lines(size_t offset) {
+		offset = std::min(offset, offset_of(end));
+		while (lines_scanned < offset) {
+			const void* newline = memchr(begin + (lines_scanned - base), '\n', offset - lines_scanned);
+			if (newline == nullptr) {
+				lines_scanned = offset;
+				break;
+			}
+			lines_scanned = offset_of((const char*)newline) + 1;
+			add_line(lines_scanned);
+		}
+	}
+
+	static size_t read_length(const unsigned char*& at) {
+		size_t length = 0;
+		for (unsigned shift = 0; ; shift += 7) {
+			length |= (size_t)(*at & 0x7f) << shift;
+			if ((*at++ & 0x80) == 0) return length;
+		}
+	}
+
+	// when streaming, lines take a byte or two each rather than a whole offset, since the line
+	// table is all that's kept of the text once it's been let go of
+	void lexer::add_line(size_t start) {
+		if (input == nullptr) {
+			line_starts.push_back(start);
+			return;
+		}
+		if (line_count % lines_per_block == 0) {
+			line_blocks.push_back({ (uint32_t)start, (uint32_t)line_lengths.size() });
+		}
+		else {
+			size_t length = start - last_line_start;
+			for (; length >= 0x80; length >>= 7) {
+				line_lengths.push_back((unsigned char)(length | 0x80));
+			}
+			line_lengths.push_back((unsigned char)length);
+		}
+		last_line_start = start;
+		line_count++;
+	}
+
+	size_t lexer::known_lines() {
+		return input == nullptr ? line_starts.size() : line_count;
+	}
+
+	size_t lexer::line_start(size_t line) {
+		if (input == nullptr) return line_starts[line - 1];
+		const line_block& block = line_blocks[(line - 1) / lines_per_block];
+		size_t start = block.start;
+		const unsigned char* length = line_lengths.data() + block.lengths;
+		for (size_t i = (line - 1) % lines_per_block; i > 0; --i) {
+			start += read_length(length);
+		}
+		return start;
+	}
+
+	// streaming only: drops what the cursor has passed in the window, all but about the last
+	// history_length of it, and reads whole lines onto the end; the lines that diagnostics
+	// found so far point at are kept first, while they're still there to keep; false once the
+	// input has run out, or been clipped
+	bool lexer::refill() {
+		if (input == nullptr || clipped || (end == buffer.data() + buffer.size() && !*input)) return false;
+		index_lines(offset_of(end));
+		notice(diagnostics, noticed, loc_base);
+		notice(lex_diagnostics, noticed_lex, 0);
+		size_t held = (size_t)(end - begin);
+		size_t dropped = held > history_length ? held - history_length : 0;
+		if (dropped != 0) {
+			// what's held still starts at a line
+			const void* newline = memchr(begin + dropped - 1, '\n', held - dropped + 1);
+			dropped = newline == nullptr ? held : (size_t)((const char*)newline - begin) + 1;
+		}
+		buffer.erase(0, dropped);
+		base += dropped;
+		held -= dropped;
+		size_t newline = buffer.rfind('\n');
+		while ((newline == std::string::npos || newline < held) && *input) {
+			size_t read = buffer.size();
+			buffer.resize(read + block_size);
+			input->read(&buffer[read], block_size);
+			buffer.resize(read + (size_t)input->gcount());
+			newline = buffer.rfind('\n');
+		}
+		begin = buffer.data();
+		cur = begin + held;
+		end = begin + (newline == std::string::npos || newline < held ? buffer.size() : newline + 1);
+		clip();
+		return cur != end;
+	}
+
+	// keeps the first and last lines of every diagnostic in found from from on that's in this
+	// source, whose offsets base was added to; found can be emptied in between, and then it's
+	// looked through from the start
+	void lexer::notice(const std::vector<diagnostic>& found, size_t& from, source_loc base) {
+		for (from = std::min(from, found.size()); from < found.size(); ++from) {
+			const diagnostic& d = found[from];
+			size_t start = d.range.loc - base;
+			if (!is_set(d.range) || start >= room) continue;
+			keep_line(line_of(start));
+			keep_line(line_of(last_loc(d.range) - base));
+		}
+	}
+
+	// copies the start of a line that's still held, until snippet_budget runs out
+	void lexer::keep_line(size_t line) {
+		if (snippets.count(line) != 0 || line_start(line) < base) return;
+		std::string_view text = this->line(line).substr(0, snippet_length);
+		if (snippet_bytes + text.size() > snippet_budget) return;
+		snippet_bytes += text.size();
+		snippets.emplace(line, text);
+	}
+
+	// cuts the source short once it runs past its room, with an error where it stops, since
+	// nothing after that could be given a location; offsets go up to the size, for <eof>
+	void lexer::clip() {
+		if (clipped || offset_of(end) < room) return;
+		clipped = true;
+		end = begin + (room - 1 - base);
+		cur = std::min(cur, end);
+		diagnostics.push_back({ "source too long to be given locations; the rest of it isn't read"s,
+			make_range(start_loc, room - 1, room - 1) });
+	}
+
+	token lexer::next_internal() {
 		auto is_digit = [](char c) {
 			return c >= '0' && c <= '9';
 		};
@@ -105,44 +458,591 @@ namespace origin {
 				|| (c >= '0' && c <= '9')
 				|| c == '_' || c == '$';
 		};
-		size_t begin = (size_t)input.tellg();
-		if (is_digit(c)) {
-			std::string data = read_while(is_digit);
-			return { token_type::number, &input, data, begin, (size_t)input.tellg() - 1 };
-		}
-		else if (is_identifier(c) || c == '@') {
-			bool is_raw = false;
-			if (c == '@') {
-				is_raw = true;
-				input.get();
-			}
-			std::string data = read_while(is_identifier);
-			bool is_keyword = false;
-			if (!is_raw) for (const char* const* kw = keywords; *kw != nullptr; kw++) {
-				if (data == *kw) {
-					is_keyword = true;
+		const char* newline = nullptr;
+		has_ln = false;
+		while (true) {
+			cur = skip_whitespace(cur, end, newline);
+			if (newline != nullptr && !has_ln) {
+				has_ln = true;
+				size_t ln = offset_of(newline);
+				ln_token = { token_type::invalid_token, loc_base, 0, ln, ln };
+			}
+			if (cur == end) {
+				if (refill()) continue;
+				size_t index = offset_of(end);
+				return { token_type::eof, loc_base, 0, index, index };
+			}
+			if (end - cur >= 2 && cur[0] == '/' && cur[1] == '/') {
+				// the newline ending the comment is consumed along with it
+				cur = skip_line(cur + 2, end);
+				continue;
+			}
+			else if (end - cur >= 2 && cur[0] == '/' && cur[1] == '*') {
+				cur = skip_block_comment(cur + 2, end);
+				while (cur == end && refill()) {
+					cur = skip_block_comment(cur, end);
+				}
+				continue;
+			}
+			char c = *cur;
+			const char* start = cur;
+			size_t begin = offset_of(cur);
+			if (is_digit(c)) {
+				while (cur != end && is_digit(*cur)) {
+					cur++;
+				}
+				atom data = names.intern(std::string_view(start, cur - start));
+				return { token_type::number, loc_base, data, begin, offset_of(cur) - 1 };
+			}
+			else if (is_identifier(c) || c == '@') {
+				bool is_raw = false;
+				if (c == '@') {
+					is_raw = true;
+					start = ++cur;
+				}
+				while (cur != end && is_identifier(*cur)) {
+					cur++;
+				}
+				token_kind kind = is_raw ? token_kind::none : lookup_kind(start, cur);
+				if (!is_keyword(kind)) kind = token_kind::none;
+				atom data = kind != token_kind::none ? (atom)kind
+					: names.intern(std::string_view(start, cur - start));
+				return { kind != token_kind::none ? token_type::keyword
+					: token_type::identifier, loc_base, data, begin, offset_of(cur) - 1, kind };
+			}
+			else {
+				const char* match_end = cur;
+				token_kind kind = match_symbol(cur, end, match_end);
+				if (kind != token_kind::none) {
+					cur = match_end;
+					return { token_type::symbol, loc_base, (atom)kind, begin,
+						offset_of(cur) - 1, kind };
+				}
+				cur++;
+				diagnostics.push_back({ "unexpected character '"s + c + "'", make_range(loc_base, begin, begin) });
+			}
+		}
+	}
+
+	// keyword and symbol spellings are interned first, so their atoms are their kinds
+	static token_kind kind_of(token_type type, atom value) {
+		if (type != token_type::keyword && type != token_type::symbol) return token_kind::none;
+		return value < kind_count ? (token_kind)value : token_kind::none;
+	}
+
+	lexer::lexer(std::string_view source,
+		std::vector<diagnostic>& diagnostics, interner& names)
+		: begin(source.data()), cur(begin),
+		end(begin + source.size()), diagnostics(diagnostics), names(names) {
+		clip();
+	}
+
+	lexer::lexer(std::istream& input,
+		std::vector<diagnostic>& diagnostics, interner& names)
+		: buffer(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()),
+		diagnostics(diagnostics), names(names) {
+		begin = cur = buffer.data();
+		end = begin + buffer.size();
+		clip();
+	}
+
+	// reads the input a block at a time instead of all at once, keeping only the lines that
+	// haven't been lexed yet and a few that have; tokens are lexed as they're asked for and let
+	// go of once nothing can restore back to them
+	lexer::lexer(std::istream& input,
+		std::vector<diagnostic>& diagnostics, interner& names, size_t block_size)
+		: tokenized(true), line_blocks({ { 0, 0 } }), block_size(block_size), input(&input),
+		diagnostics(diagnostics), names(names) {
+		begin = cur = end = buffer.data();
+	}
+
+	std::string_view lexer::source() {
+		return std::string_view(begin, end - begin);
+	}
+
+	// whether the source is read a block at a time, so that its size isn't known up front
+	bool lexer::streaming() {
+		return input != nullptr;
+	}
+
+	// puts the source at base among the compilation's locations, with room for that many of
+	// them, before anything is lexed; see clip()
+	void lexer::place(source_loc base, size_t room) {
+		loc_base = start_loc = base;
+		this->room = room;
+		clip();
+	}
+
+	source_loc lexer::first_loc() {
+		return start_loc;
+	}
+
+	// the offset a location handed out by this lexer is at now, going by the runs a parser
+	// opened; one in none of them is taken to be where the source was placed plus its offset
+	size_t lexer::offset_at(source_loc loc) {
+		if (!runs_sorted) {
+			// runs kept from the same earlier one overlap where a declaration looked past the
+			// start of the next, and agree there, so each is cut down to what those before it
+			// don't have
+			std::sort(runs.begin(), runs.end(), [](const loc_run& a, const loc_run& b) { return a.loc < b.loc; });
+			size_t kept = 0;
+			for (loc_run run : runs) {
+				if (kept != 0) {
+					size_t covered = (size_t)runs[kept - 1].loc + runs[kept - 1].length;
+					if (covered >= (size_t)run.loc + run.length) continue;
+					if (covered > run.loc) {
+						size_t cut = covered - run.loc;
+						run.loc += (source_loc)cut;
+						run.length -= cut;
+						run.offset += cut;
+					}
+				}
+				runs[kept++] = run;
+			}
+			runs.resize(kept);
+			runs_sorted = true;
+		}
+		auto after = std::upper_bound(runs.begin(), runs.end(), loc,
+			[](source_loc loc, const loc_run& run) { return loc < run.loc; });
+		if (after != runs.begin() && loc - (after - 1)->loc < (after - 1)->length) {
+			return (after - 1)->offset + (loc - (after - 1)->loc);
+		}
+		return loc - start_loc;
+	}
+
+	// a parser reading the source hands out locations a run at a time, each a stretch of the
+	// source's own locations that no run has had yet, so that the locations of a declaration it
+	// keeps from an earlier read stay where they were however far the declaration has moved;
+	// see parser::reparse; this forgets the runs, and unless keep_used, starts handing out the
+	// source's locations from the first again
+	void lexer::reset_runs(bool keep_used) {
+		runs.clear();
+		runs_sorted = true;
+		if (!keep_used) used = 0;
+	}
+
+	// how many of the source's locations no run has had
+	size_t lexer::room_left() {
+		return room - used;
+	}
+
+	// starts a run at offset, which nothing handed out from then on comes before; it can need
+	// as many locations as there are offsets from there to the end
+	void lexer::open_run(size_t offset) {
+		run_offset = run_last = offset;
+		loc_base = make_loc(start_loc, used) - (source_loc)offset;
+	}
+
+	// gives the open run the locations up to the furthest token handed out in it
+	void lexer::close_run() {
+		size_t length = run_last - run_offset + 1;
+		runs.push_back({ make_loc(start_loc, used), length, run_offset });
+		runs_sorted = false;
+		used += length;
+	}
+
+	// puts locations handed out by an earlier run, for what's now at offset, among the runs
+	void lexer::keep_run(source_loc loc, size_t length, size_t offset) {
+		runs.push_back({ loc, length, offset });
+		runs_sorted = false;
+	}
+
+	// lines are numbered from 1 and columns from 0, as byte offsets from the start of the line
+	size_t lexer::line_of(size_t offset) {
+		index_lines(offset);
+		if (input == nullptr) {
+			return (size_t)(std::upper_bound(line_starts.begin(), line_starts.end(), offset) - line_starts.begin());
+		}
+		auto block = std::upper_bound(line_blocks.begin(), line_blocks.end(), offset,
+			[](size_t offset, const line_block& block) { return offset < block.start; }) - 1;
+		size_t line = (size_t)(block - line_blocks.begin()) * lines_per_block + 1;
+		size_t start = block->start;
+		const unsigned char* length = line_lengths.data() + block->lengths;
+		for (; line < line_count && line % lines_per_block != 0; ++line) {
+			size_t next = start + read_length(length);
+			if (next > offset) break;
+			start = next;
+		}
+		return line;
+	}
+
+	size_t lexer::column_of(size_t offset) {
+		return offset - line_start(line_of(offset));
+	}
+
+	// the text of a line, without its newline; once streamed past, only the start of a line
+	// that a diagnostic pointed at is left, and other lines come back empty
+	std::string_view lexer::line(size_t line) {
+		if (known_lines() < line) {
+			index_lines(offset_of(end));
+		}
+		if (line == 0 || line > known_lines()) return std::string_view();
+		size_t start = line_start(line);
+		if (start < base) {
+			auto kept = snippets.find(line);
+			return kept == snippets.end() ? std::string_view() : std::string_view(kept->second);
+		}
+		const char* from = begin + (start - base);
+		const void* newline = memchr(from, '\n', end - from);
+		const char* to = newline == nullptr ? end : (const char*)newline;
+		return std::string_view(from, to - from);
+	}
+
+	// lexes the rest of the input into tokens up front, so that the cursor, save() and restore()
+	// only move an index around; must be called before anything has been saved
+	void lexer::tokenize() {
+		if (tokenized) return;
+		if (has_peeked) {
+			tokens.push_back({ peeked, has_ln ? ln_token.start : no_newline, 0 });
+		}
+		while (tokens.empty() || tokens.back().token.type != token_type::eof) {
+			push_token();
+		}
+		tokenized = true;
+		index = 0;
+	}
+
+	// a stretch of the input lexed apart by a lexer of its own, with atoms from its own interner
+	struct lexer::lex_chunk {
+		std::vector<diagnostic> diagnostics;
+		interner names;
+		lexer lex;
+		std::vector<atom> atoms;
+
+		lex_chunk(std::string_view source) : lex(source, diagnostics, names) {}
+	};
+
+	// copies the chunk's tokens from index `from` on, along with their diagnostics; atoms from
+	// the chunk's interner are interned here in token order unless the chunk has been mapped
+	// already, so they come out numbered just as they would have been by tokenize()
+	void lexer::append(lex_chunk& chunk, size_t from) {
+		const std::vector<lexed_token>& source = chunk.lex.tokens;
+		const std::vector<diagnostic>& source_diagnostics = chunk.lex.lex_diagnostics;
+		chunk.atoms.resize(chunk.names.size());
+		for (size_t i = from; i < source.size(); ++i) {
+			lexed_token entry = source[i];
+			size_t last = i + 1 < source.size() ? source[i + 1].diagnostics : source_diagnostics.size();
+			entry.diagnostics = lex_diagnostics.size();
+			for (size_t j = source[i].diagnostics; j < last; ++j) {
+				lex_diagnostics.push_back(source_diagnostics[j]);
+			}
+			if (entry.token.value >= kind_count) {
+				atom& mapped = chunk.atoms[entry.token.value];
+				if (mapped == 0) {
+					mapped = names.intern(chunk.names.get(entry.token.value));
+				}
+				entry.token.value = mapped;
+			}
+			tokens.push_back(entry);
+		}
+	}
+
+	// tokenizes several lexers sharing one interner, each on a thread of its own; every input is
+	// lexed with a private interner, whose atoms are then interned into the shared one a lexer at
+	// a time, so they're numbered just as they would have been by tokenize() on each in turn
+	void lexer::tokenize(const std::vector<lexer*>& lexers, size_t threads) {
+		if (threads == 0) {
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		std::vector<lexer*> pending;
+		std::deque<lex_chunk> chunks;
+		for (lexer* lex : lexers) {
+			if (lex->tokenized || lex->has_peeked || lex->cur != lex->begin) {
+				lex->tokenize();
+				continue;
+			}
+			pending.push_back(lex);
+			chunks.emplace_back(lex->source());
+		}
+
+		// runs task(i) for every chunk, spread over the threads
+		auto run = [&](auto task) {
+			std::atomic<size_t> next_chunk = 0;
+			auto work = [&]() {
+				for (size_t i; (i = next_chunk++) < chunks.size();) {
+					task(i);
+				}
+			};
+			std::vector<std::thread> pool;
+			for (size_t i = 1; i < std::min(threads, chunks.size()); ++i) {
+				pool.emplace_back(work);
+			}
+			work();
+			for (std::thread& thread : pool) {
+				thread.join();
+			}
+		};
+
+		run([&](size_t i) {
+			chunks[i].lex.tokenize();
+		});
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			lex_chunk& chunk = chunks[i];
+			chunk.atoms.resize(chunk.names.size());
+			for (atom value = (atom)kind_count; value < chunk.atoms.size(); ++value) {
+				chunk.atoms[value] = pending[i]->names.intern(chunk.names.get(value));
+			}
+		}
+		run([&](size_t i) {
+			lexer& lex = *pending[i];
+			lexer& from = chunks[i].lex;
+			lex.append(chunks[i], 0);
+			lex.line_starts = std::move(from.line_starts);
+			lex.lines_scanned = from.lines_scanned;
+			lex.cur = lex.end;
+			lex.scanned = (size_t)(lex.end - lex.begin);
+			lex.tokenized = true;
+			lex.index = 0;
+		});
+	}
+
+	// like tokenize(), but the text is split at line starts into chunks that are lexed on
+	// separate threads; a chunk may begin inside a block comment, so the chunks are stitched
+	// together by lexing serially from the end of the previous one until a token lines up
+	void lexer::tokenize(size_t threads, size_t chunk_size) {
+		if (tokenized) return;
+		size_t size = (size_t)(end - begin);
+		if (threads == 0) {
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		if (threads == 1 || has_peeked || cur != begin || size <= chunk_size) {
+			tokenize();
+			return;
+		}
+
+		std::vector<size_t> starts = { 0 };
+		for (size_t at = chunk_size; at < size; at = starts.back() + chunk_size) {
+			const void* newline = memchr(begin + at, '\n', size - at);
+			if (newline == nullptr || (const char*)newline + 1 == end) break;
+			starts.push_back((size_t)((const char*)newline - begin) + 1);
+		}
+
+		std::deque<lex_chunk> chunks;
+		for (size_t start : starts) {
+			lexer& lex = chunks.emplace_back(source()).lex;
+			lex.cur = lex.begin + start;
+			// the chunk's own line table is never used
+			lex.lines_scanned = start;
+		}
+
+		std::atomic<size_t> next_chunk = 0;
+		auto work = [&]() {
+			for (size_t i; (i = next_chunk++) < chunks.size();) {
+				lexer& lex = chunks[i].lex;
+				size_t stop = i + 1 < starts.size() ? starts[i + 1] : size;
+				while (true) {
+					const token& token = lex.push_token();
+					if (token.type == token_type::eof || token.start >= stop) break;
+				}
+			}
+		};
+		std::vector<std::thread> pool;
+		for (size_t i = 1; i < std::min(threads, chunks.size()); ++i) {
+			pool.emplace_back(work);
+		}
+		work();
+		for (std::thread& thread : pool) {
+			thread.join();
+		}
+
+		append(chunks[0], 0);
+		for (size_t i = 1; i < chunks.size(); ++i) {
+			const std::vector<lexed_token>& guess = chunks[i].lex.tokens;
+			size_t stop = i + 1 < starts.size() ? starts[i + 1] : size;
+			while (tokens.back().token.type != token_type::eof && tokens.back().token.start < stop) {
+				size_t start = tokens.back().token.start;
+				auto found = std::lower_bound(guess.begin(), guess.end(), start,
+					[](const lexed_token& entry, size_t start) { return entry.token.start < start; });
+				if (found != guess.end() && found->token.start == start) {
+					append(chunks[i], (size_t)(found - guess.begin()) + 1);
 					break;
 				}
+				cur = begin + tokens.back().token.end + 1;
+				push_token();
 			}
-			return { is_keyword ? token_type::keyword
-				: token_type::identifier, &input, data, begin, (size_t)input.tellg() - 1 };
+		}
+		while (tokens.back().token.type != token_type::eof) {
+			cur = begin + tokens.back().token.end + 1;
+			push_token();
+		}
+		cur = end;
+		scanned = size;
+		tokenized = true;
+		index = 0;
+	}
+
+	// lexes one more token, moving its diagnostics onto the end of into; they're kept by offset,
+	// and only given locations as they're replayed
+	lexer::lexed_token lexer::lex_entry(std::vector<diagnostic>& into) {
+		size_t first = diagnostics.size();
+		token token = lex();
+		lexed_token entry = { token, has_ln ? ln_token.start : no_newline, into.size() };
+		for (size_t i = first; i < diagnostics.size(); ++i) {
+			into.push_back(std::move(diagnostics[i]));
+			into.back().range.loc -= loc_base;
+		}
+		diagnostics.erase(diagnostics.begin() + first, diagnostics.end());
+		noticed = std::min(noticed, first);
+		return entry;
+	}
+
+	// lexes one more token onto the end of tokens, taking its diagnostics with it
+	const token& lexer::push_token() {
+		tokens.push_back(lex_entry(lex_diagnostics));
+		return tokens.back().token;
+	}
+
+	// puts replacement in place of [first, last), moving what comes after only once
+	template<class T>
+	static void splice(std::vector<T>& into, size_t first, size_t last, std::vector<T>& replacement) {
+		size_t common = std::min(last - first, replacement.size());
+		std::move(replacement.begin(), replacement.begin() + common, into.begin() + first);
+		if (common < last - first) {
+			into.erase(into.begin() + first + common, into.begin() + last);
 		}
 		else {
-			for (const char* const* op = symbols; *op != nullptr; op++) {
-				std::string s(*op);
-				if (next_is(input, s)) {
-					return { token_type::symbol, &input, s, begin, (size_t)input.tellg() - 1 };
-				}
+			into.insert(into.begin() + last, std::make_move_iterator(replacement.begin() + common),
+				std::make_move_iterator(replacement.end()));
+		}
+	}
+
+	// replaces removed characters at offset with inserted, then relexes from the last token
+	// that the edit can't have changed until the new tokens line up with the old ones again;
+	// the new tokens take the place of the ones they cover, the rest are shifted where they
+	// are, and the cursor goes back to the first token
+	size_t lexer::edit(size_t offset, size_t removed, std::string_view inserted) {
+		if (input != nullptr) return 0;
+		size_t old_size = (size_t)(end - begin);
+		if (begin != buffer.data()) {
+			buffer.assign(begin, old_size);
+		}
+		// anything clipped off before is gone for good
+		buffer.resize(old_size);
+		buffer.replace(offset, removed, inserted);
+		begin = buffer.data();
+		end = begin + buffer.size();
+		clipped = false;
+		clip();
+		ptrdiff_t delta = (ptrdiff_t)inserted.size() - (ptrdiff_t)removed;
+		shift_lines(offset, removed, inserted);
+		index = 0;
+		has_peeked = false;
+		last_token = {};
+		if (!tokenized) {
+			cur = begin;
+			scanned = 0;
+			return 0;
+		}
+
+		size_t first = (size_t)(std::partition_point(tokens.begin(), tokens.end(), [&](const lexed_token& entry) {
+			return entry.token.end + longest_symbol() < offset;
+		}) - tokens.begin());
+		size_t restart = first == 0 ? 0 : tokens[first - 1].token.end + 1;
+		size_t first_diagnostic = first < tokens.size() ? tokens[first].diagnostics : lex_diagnostics.size();
+
+		cur = begin + restart;
+		scanned = restart;
+		size_t edit_end = offset + inserted.size();
+		std::vector<lexed_token> fresh;
+		std::vector<diagnostic> fresh_diagnostics;
+		// the old token that the last one relexed lines up with, or the end
+		size_t old = first;
+		while (true) {
+			lexed_token entry = lex_entry(fresh_diagnostics);
+			entry.diagnostics += first_diagnostic;
+			fresh.push_back(entry);
+			if (entry.token.type == token_type::eof) {
+				old = tokens.size();
+				break;
 			}
-			input.get();
-			diagnostics.push_back({ "unexpected character '"s + c + "'", &input, begin, begin });
-			return next_internal(local_ln, local_ln_token);
+			if (entry.token.start < edit_end) continue;
+			// past the edit, the text is the same as before, so once a token starts where an old
+			// one did, everything after it is the same too
+			size_t old_start = (size_t)((ptrdiff_t)entry.token.start - delta);
+			while (old < tokens.size() && tokens[old].token.start < old_start) {
+				old++;
+			}
+			if (old < tokens.size() && tokens[old].token.start == old_start) {
+				break;
+			}
+		}
+		size_t kept = old < tokens.size() ? old + 1 : tokens.size();
+		size_t kept_diagnostic = kept < tokens.size() ? tokens[kept].diagnostics : lex_diagnostics.size();
+		size_t count = fresh.size();
+		ptrdiff_t diagnostic_delta = (ptrdiff_t)fresh_diagnostics.size() - (ptrdiff_t)(kept_diagnostic - first_diagnostic);
+		size_t shifted_diagnostic = first_diagnostic + fresh_diagnostics.size();
+		splice(tokens, first, kept, fresh);
+		splice(lex_diagnostics, first_diagnostic, kept_diagnostic, fresh_diagnostics);
+		for (size_t i = first + count; i < tokens.size(); ++i) {
+			lexed_token& entry = tokens[i];
+			entry.token.start += delta;
+			entry.token.end += delta;
+			if (entry.newline != no_newline) entry.newline += delta;
+			entry.diagnostics += diagnostic_delta;
 		}
+		for (size_t i = shifted_diagnostic; i < lex_diagnostics.size(); ++i) {
+			lex_diagnostics[i].range = moved(lex_diagnostics[i].range, delta);
+		}
+		scanned = (size_t)(end - begin);
+		cur = end;
+		return count;
 	}
 
-	lexer::lexer(std::istream& input,
-		std::vector<diagnostic>& diagnostics)
-		: input(input), diagnostics(diagnostics) {
+	// keeps the line-start table in step with an edit, without rescanning the rest of the text
+	void lexer::shift_lines(size_t offset, size_t removed, std::string_view inserted) {
+		if (lines_scanned <= offset) return;
+		auto first = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+		if (lines_scanned < offset + removed) {
+			line_starts.erase(first, line_starts.end());
+			lines_scanned = offset;
+			return;
+		}
+		auto last = std::upper_bound(first, line_starts.end(), offset + removed);
+		first = line_starts.erase(first, last);
+		for (auto it = first; it != line_starts.end(); ++it) {
+			*it = *it - removed + inserted.size();
+		}
+		std::vector<size_t> added;
+		for (size_t i = 0; i < inserted.size(); ++i) {
+			if (inserted[i] == '\n') added.push_back(offset + i + 1);
+		}
+		line_starts.insert(first, added.begin(), added.end());
+		lines_scanned = lines_scanned - removed + inserted.size();
+	}
+
+	size_t lexer::relexed() {
+		return relexed_chars;
+	}
+
+	// bytes held in the lexer's own buffers, not counting the source
+	size_t lexer::footprint() {
+		size_t bytes = tokens.capacity() * sizeof(lexed_token) + state.capacity() * sizeof(lexer_state)
+			+ line_starts.capacity() * sizeof(size_t) + line_blocks.capacity() * sizeof(line_block)
+			+ line_lengths.capacity() + runs.capacity() * sizeof(loc_run) + snippet_bytes;
+		// a map node holds a snippet's line and string, besides its links
+		bytes += snippets.size() * (sizeof(size_t) + sizeof(std::string) + 4 * sizeof(void*));
+		for (const diagnostic& d : lex_diagnostics) {
+			bytes += d.message.capacity() + d.template_str.capacity();
+		}
+		return bytes + lex_diagnostics.capacity() * sizeof(diagnostic);
+	}
+
+	// makes the token at the cursor look freshly lexed: its diagnostics are emitted again,
+	// and has_newline() refers to it, just as if next_internal() had just returned it; once
+	// the cursor has moved past <eof>, it is lexed again with no whitespace in front of it
+	void lexer::replay() {
+		if (index == tokens.size() || index == limit) {
+			has_ln = false;
+			return;
+		}
+		const lexed_token& entry = tokens[index];
+		size_t last = index + 1 < tokens.size() ? tokens[index + 1].diagnostics : lex_diagnostics.size();
+		for (size_t i = entry.diagnostics; i < last; ++i) {
+			diagnostics.push_back(lex_diagnostics[i]);
+			diagnostics.back().range.loc = make_loc(loc_base, lex_diagnostics[i].range.loc);
+		}
+		has_ln = entry.newline != no_newline;
+		ln_token = { token_type::invalid_token, loc_base, 0, entry.newline, entry.newline };
 	}
 
 	bool lexer::eof() {
@@ -153,10 +1053,14 @@ namespace origin {
 		return peek().type == type;
 	}
 
-	bool lexer::is_next(token_type type, const std::string& value) {
+	bool lexer::is_next(token_type type, atom value) {
 		return peek().type == type && peek().value == value;
 	}
 
+	bool lexer::is_next(token_kind kind) {
+		return peek().kind == kind;
+	}
+
 	bool lexer::has_newline() {
 		return has_ln;
 	}
@@ -165,7 +1069,7 @@ namespace origin {
 		return ln_token;
 	}
 
-	bool lexer::try_to_close(token_type type, const std::string& open, const std::string& close) {
+	bool lexer::try_to_close(token_kind open, token_kind close) {
 		save();
 		int level = 1;
 		token start = peek();
@@ -178,15 +1082,15 @@ namespace origin {
 			}
 			else {
 				next();
-				if (token.type == type && token.value == open) {
+				if (token.kind == open) {
 					level++;
 				}
-				else if (token.type == type && token.value == close) {
+				else if (token.kind == close) {
 					level--;
 				}
 				if (level == 0) {
 					discard();
-					diagnostics.push_back({ "unexpected token(s)", &input, start.start, end.end });
+					diagnostics.push_back({ "unexpected token(s)", make_range(loc_base, start.start, end.end) });
 					return true;
 				}
 				else {
@@ -201,23 +1105,48 @@ namespace origin {
 	}
 
 	token lexer::next() {
+		if (tokenized) {
+			last_token = peek();
+			if (index < std::min(tokens.size(), limit)) index++;
+			has_peeked = false;
+			if (input != nullptr) {
+				trim();
+			}
+			return last_token;
+		}
 		if (has_peeked) {
 			has_peeked = false;
 			last_token = peeked;
 			return peeked;
 		}
 		else {
-			return last_token = next_internal();
+			return last_token = lex();
 		}
 	}
 
 	token lexer::peek() {
+		if (tokenized) {
+			while (input != nullptr && index >= tokens.size()
+				&& (tokens.empty() || tokens.back().token.type != token_type::eof)) {
+				push_token();
+			}
+			if (!has_peeked) {
+				has_peeked = true;
+				replay();
+			}
+			reach = std::max(reach, index);
+			if (index >= limit) {
+				token end = tokens[std::min(index, tokens.size() - 1)].token;
+				return hand_out({ token_type::eof, loc_base, 0, end.start, end.start });
+			}
+			return hand_out(tokens[std::min(index, tokens.size() - 1)].token);
+		}
 		if (has_peeked) {
 			return peeked;
 		}
 		else {
 			has_peeked = true;
-			return peeked = next_internal();
+			return peeked = lex();
 		}
 	}
 
@@ -225,24 +1154,26 @@ namespace origin {
 		token next_token = next();
 		if (next_token.type != type) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type }, false) << ", found "
-				<< encode_token(next_token, false);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type }, false, names) << ", found "
+				<< encode_token(next_token, false, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
-			next_token.value = "";
+			next_token.value = 0;
+			next_token.kind = token_kind::none;
 		}
 		return next_token;
 	}
 
-	token lexer::consume(token_type type, const std::string& value) {
+	token lexer::consume(token_type type, atom value) {
 		token next_token = next();
 		if (next_token.type != type || next_token.value != value) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type, &input, value }, true) << ", found "
-				<< encode_token(next_token, true);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type, loc_base, value }, true, names) << ", found "
+				<< encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
 			next_token.value = value;
+			next_token.kind = kind_of(type, value);
 		}
 		return next_token;
 	}
@@ -251,24 +1182,26 @@ namespace origin {
 		token next_token = next();
 		if (next_token.type != type) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type }, false) << " " << message
-				<< ", found " << encode_token(next_token, false);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type }, false, names) << " " << message
+				<< ", found " << encode_token(next_token, false, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
-			next_token.value = "";
+			next_token.value = 0;
+			next_token.kind = token_kind::none;
 		}
 		return next_token;
 	}
 
-	token lexer::consume_msg(token_type type, const std::string& value, const std::string& message) {
+	token lexer::consume_msg(token_type type, atom value, const std::string& message) {
 		token next_token = next();
 		if (next_token.type != type || next_token.value != value) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type, &input, value }, true) << " " << message
-				<< ", found " << encode_token(next_token, true);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type, loc_base, value }, true, names) << " " << message
+				<< ", found " << encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
 			next_token.value = value;
+			next_token.kind = kind_of(type, value);
 		}
 		return next_token;
 	}
@@ -277,11 +1210,12 @@ namespace origin {
 		token next_token = peek();
 		if (next_token.type != type) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type }, false) << ", found "
-				<< encode_token(next_token, false);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type }, false, names) << ", found "
+				<< encode_token(next_token, false, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
-			next_token.value = "";
+			next_token.value = 0;
+			next_token.kind = token_kind::none;
 		}
 		else {
 			next();
@@ -289,15 +1223,16 @@ namespace origin {
 		return next_token;
 	}
 
-	token lexer::read(token_type type, const std::string& value) {
+	token lexer::read(token_type type, atom value) {
 		token next_token = peek();
 		if (next_token.type != type || next_token.value != value) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type, &input, value }, true) << ", found "
-				<< encode_token(next_token, true);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type, loc_base, value }, true, names) << ", found "
+				<< encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
 			next_token.value = value;
+			next_token.kind = kind_of(type, value);
 		}
 		else {
 			next();
@@ -309,11 +1244,12 @@ namespace origin {
 		token next_token = peek();
 		if (next_token.type != type) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type }, false) << " " << message
-				<< ", found " << encode_token(next_token, false);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type }, false, names) << " " << message
+				<< ", found " << encode_token(next_token, false, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
-			next_token.value = "";
+			next_token.value = 0;
+			next_token.kind = token_kind::none;
 		}
 		else {
 			next();
@@ -321,15 +1257,82 @@ namespace origin {
 		return next_token;
 	}
 
-	token lexer::read_msg(token_type type, const std::string& value, const std::string& message) {
+	token lexer::read_msg(token_type type, atom value, const std::string& message) {
 		token next_token = peek();
 		if (next_token.type != type || next_token.value != value) {
 			std::ostringstream s;
-			s << "expected " << encode_token({ type, &input, value }, true) << " " << message
-				<< ", found " << encode_token(next_token, true);
-			diagnostics.push_back({ s.str(), &input, next_token.start, next_token.end });
+			s << "expected " << encode_token({ type, loc_base, value }, true, names) << " " << message
+				<< ", found " << encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
 			next_token.type = type;
 			next_token.value = value;
+			next_token.kind = kind_of(type, value);
+		}
+		else {
+			next();
+		}
+		return next_token;
+	}
+
+	static token_type type_of(token_kind kind) {
+		return is_keyword(kind) ? token_type::keyword : token_type::symbol;
+	}
+
+	token lexer::consume(token_kind kind) {
+		token next_token = next();
+		if (next_token.kind != kind) {
+			std::ostringstream s;
+			s << "expected " << encode_token({ type_of(kind), loc_base, (atom)kind }, true, names) << ", found "
+				<< encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
+			next_token.type = type_of(kind);
+			next_token.value = (atom)kind;
+			next_token.kind = kind;
+		}
+		return next_token;
+	}
+
+	token lexer::consume_msg(token_kind kind, const std::string& message) {
+		token next_token = next();
+		if (next_token.kind != kind) {
+			std::ostringstream s;
+			s << "expected " << encode_token({ type_of(kind), loc_base, (atom)kind }, true, names) << " " << message
+				<< ", found " << encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
+			next_token.type = type_of(kind);
+			next_token.value = (atom)kind;
+			next_token.kind = kind;
+		}
+		return next_token;
+	}
+
+	token lexer::read(token_kind kind) {
+		token next_token = peek();
+		if (next_token.kind != kind) {
+			std::ostringstream s;
+			s << "expected " << encode_token({ type_of(kind), loc_base, (atom)kind }, true, names) << ", found "
+				<< encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
+			next_token.type = type_of(kind);
+			next_token.value = (atom)kind;
+			next_token.kind = kind;
+		}
+		else {
+			next();
+		}
+		return next_token;
+	}
+
+	token lexer::read_msg(token_kind kind, const std::string& message) {
+		token next_token = peek();
+		if (next_token.kind != kind) {
+			std::ostringstream s;
+			s << "expected " << encode_token({ type_of(kind), loc_base, (atom)kind }, true, names) << " " << message
+				<< ", found " << encode_token(next_token, true, names);
+			diagnostics.push_back({ s.str(), make_range(loc_base, next_token.start, next_token.end) });
+			next_token.type = type_of(kind);
+			next_token.value = (atom)kind;
+			next_token.kind = kind;
 		}
 		else {
 			next();
@@ -338,14 +1341,20 @@ namespace origin {
 	}
 
 	void lexer::save() {
-		state.push_back({ diagnostics.size(), input.tellg(), has_peeked, peeked });
+		state.push_back({ diagnostics.size(), tokenized ? index : (size_t)(cur - begin),
+			has_peeked, peeked });
 	}
 
 	void lexer::restore() {
 		lexer_state s = state.back();
 		state.pop_back();
 		while (diagnostics.size() != s.diagnostics) diagnostics.pop_back();
-		input.seekg(s.input);
+		if (tokenized) {
+			index = s.position;
+		}
+		else {
+			cur = begin + s.position;
+		}
 		has_peeked = s.has_peeked;
 		peeked = s.peeked;
 	}
@@ -354,7 +1363,122 @@ namespace origin {
 		state.pop_back();
 	}
 
-	std::string encode_token(token token, bool include_value) {
+	// the cursor can only be moved around freely once the whole input is in tokens
+	bool lexer::can_seek() {
+		return tokenized && input == nullptr;
+	}
+
+	size_t lexer::tell() {
+		peek();
+		return index;
+	}
+
+	// moves the cursor to a position from tell(); the token there has already been peeked at,
+	// so its diagnostics aren't emitted again, and the input looks as if it ends at limit
+	void lexer::seek(size_t position, size_t limit) {
+		this->limit = limit;
+		index = position;
+		has_peeked = true;
+		const lexed_token& entry = tokens[std::min(index, tokens.size() - 1)];
+		has_ln = index < tokens.size() && entry.newline != no_newline;
+		ln_token = { token_type::invalid_token, loc_base, 0, entry.newline, entry.newline };
+	}
+
+	// moves past a { ... } at the cursor by counting braces alone, without emitting anything
+	// for the tokens in between; false, and nothing moves, if it is never closed; the position
+	// after the closing brace is put in end
+	bool lexer::skip_braces(size_t* end) {
+		if (peek().kind != token_kind::open_brace) return false;
+		size_t level = 0;
+		for (size_t i = index; i < tokens.size(); ++i) {
+			reach = std::max(reach, i);
+			// a declaration counts what it passed over as its own, so the open run has to
+			run_last = std::max(run_last, tokens[i].token.end);
+			token_kind kind = tokens[i].token.kind;
+			if (kind == token_kind::open_brace) {
+				level++;
+			}
+			else if (kind == token_kind::close_brace && --level == 0) {
+				last_token = hand_out(tokens[i].token);
+				index = i + 1;
+				if (end != nullptr) *end = index;
+				has_peeked = false;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// reached() is the furthest position from tell() that has been looked at since the last
+	// reset_reach(), by peeking, saving and restoring, or skipping; whatever the parser read in
+	// between depends on no tokens past it
+	void lexer::reset_reach() {
+		reach = index;
+	}
+
+	size_t lexer::reached() {
+		return reach;
+	}
+
+	// the token at a position from tell(), without moving the cursor; past the end, <eof>
+	token lexer::token_at(size_t position) {
+		token result = tokens[std::min(position, tokens.size() - 1)].token;
+		result.base = loc_base;
+		return result;
+	}
+
+	// a token lexed ahead of time as the parser gets it, with the locations handed out now; the
+	// open run reaches at least as far as its end from then on
+	token lexer::hand_out(const token& token) {
+		origin::token result = token;
+		result.base = loc_base;
+		run_last = std::max(run_last, token.end);
+		return result;
+	}
+
+	// whether lexing any of the tokens at positions [from, to) from tell() gave diagnostics
+	bool lexer::reported(size_t from, size_t to) {
+		to = std::min(to, tokens.size());
+		if (from >= to) return false;
+		size_t last = to < tokens.size() ? tokens[to].diagnostics : lex_diagnostics.size();
+		return tokens[from].diagnostics != last;
+	}
+
+	// streaming only: lets go of the tokens before the cursor and before anything saved, once
+	// there are enough of them to be worth moving the rest
+	void lexer::trim() {
+		size_t keep = state.empty() ? index : std::min(index, state.front().position);
+		if (keep < 4096 || keep * 2 < tokens.size()) return;
+		size_t dropped_diagnostics = keep < tokens.size() ? tokens[keep].diagnostics : lex_diagnostics.size();
+		tokens.erase(tokens.begin(), tokens.begin() + keep);
+		lex_diagnostics.erase(lex_diagnostics.begin(), lex_diagnostics.begin() + dropped_diagnostics);
+		noticed_lex = noticed_lex > dropped_diagnostics ? noticed_lex - dropped_diagnostics : 0;
+		for (lexed_token& entry : tokens) {
+			entry.diagnostics -= dropped_diagnostics;
+		}
+		for (lexer_state& saved : state) {
+			saved.position -= keep;
+		}
+		index -= keep;
+	}
+
+	token_kind lookup_kind(std::string_view spelling) {
+		return lookup_kind(spelling.data(), spelling.data() + spelling.size());
+	}
+
+	const char* whitespace_end(const char* cur, const char* end, const char*& newline, bool plain) {
+		return plain ? skip_whitespace_plain(cur, end, newline) : skip_whitespace(cur, end, newline);
+	}
+
+	const char* block_comment_end(const char* cur, const char* end, bool plain) {
+		return plain ? skip_block_comment_plain(cur, end) : skip_block_comment(cur, end);
+	}
+
+	const char* spelling(token_kind kind) {
+		return spellings[(size_t)kind];
+	}
+
+	std::string encode_token(token token, bool include_value, const interner& names) {
 		std::ostringstream result;
 		switch (token.type) {
 		case token_type::eof:
@@ -380,8 +1504,17 @@ namespace origin {
 			break;
 		}
 		if (include_value && token.type != token_type::eof) {
-			result << " '" << token.value << "'";
+			result << " '" << names.get(token.value) << "'";
 		}
 		return result.str();
 	}
+
+	// FNV-1a, for telling whether two pieces of source are the same without keeping either
+	uint64_t hash_source(std::string_view source) {
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : source) {
+			hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+		}
+		return hash;
+	}
 }
\ No newline at end of file
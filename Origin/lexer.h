@@ -1,8 +1,13 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 #include <istream>
+#include <map>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "interner.h"
+#include "source_loc.h"
 
 namespace origin {
 	enum class token_type {
@@ -15,19 +20,57 @@ namespace origin {
 		symbol,
 	};
 
+	enum class token_kind : unsigned char {
+		none,
+
+		if_keyword, else_keyword, true_keyword, false_keyword,
+		return_keyword, do_keyword,
+		namespace_keyword, import_keyword,
+		class_keyword, struct_keyword, public_keyword, private_keyword,
+		operator_keyword,
+		alias_keyword,
+
+		shl_assign, shr_assign,
+
+		compare, ellipsis, shl, shr,
+
+		less_equal, greater_equal, increment, decrement, logical_and, logical_or, scope,
+		mul_assign, div_assign, mod_assign, add_assign, sub_assign, and_assign, or_assign, xor_assign,
+		equal, not_equal,
+
+		dot, open_bracket, close_bracket, open_paren, close_paren, tilde, bang, minus, plus, star, slash,
+		percent, less, greater, ampersand, caret, pipe, question, colon, assign, comma,
+
+		semicolon, open_brace, close_brace,
+	};
+
+	constexpr size_t token_kind_count = (size_t)token_kind::close_brace + 1;
+
 	struct token {
 		token_type type = token_type::invalid_token;
-		std::istream* stream;
-		std::string value;
+		// added to its offsets to give its locations
+		source_loc base;
+		atom value;
 		size_t start;
 		size_t end;
+		token_kind kind = token_kind::none;
 	};
 
+	inline source_loc loc_of(const token& token) {
+		return make_loc(token.base, token.start);
+	}
+
+	inline source_range range_of(const token& token) {
+		return make_range(token.base, token.start, token.end);
+	}
+
+	inline source_range range_of(const token& start, const token& end) {
+		return make_range(start.base, start.start, end.end);
+	}
+
 	struct diagnostic {
 		std::string message;
-		std::istream* stream;
-		size_t start;
-		size_t end;
+		source_range range;
 		std::string template_str;
 		bool warning = false;
 	};
@@ -36,13 +79,85 @@ namespace origin {
 	private:
 		struct lexer_state {
 			size_t diagnostics;
-			std::streampos input;
+			size_t position;
 			bool has_peeked;
 			token peeked;
 		};
 
+		// a token lexed ahead of time by tokenize(), along with the offset of the first newline
+		// before it (or no_newline) and the index of its first diagnostic in lex_diagnostics
+		struct lexed_token {
+			origin::token token;
+			size_t newline;
+			size_t diagnostics;
+		};
+
+		// a run of lines_per_block lines in a packed line table: where the first starts, and
+		// where the lengths of the lines before each of the others start in line_lengths; both
+		// fit in 32 bits, since a source has no more offsets than it has locations
+		struct line_block {
+			uint32_t start;
+			uint32_t lengths;
+		};
+
+		// locations given to a stretch of the source, from offset on, by a parser reading it
+		struct loc_run {
+			source_loc loc;
+			size_t length;
+			size_t offset;
+		};
+
+		struct lex_chunk;
+
+		static constexpr size_t no_newline = (size_t)-1;
+		static constexpr size_t lines_per_block = 64;
+		// when streaming: how much of the text lexed last is held on to, how much of a line
+		// that a diagnostic points at is kept once it's dropped, and how much of those in all
+		static constexpr size_t history_length = 1 << 16;
+		static constexpr size_t snippet_length = 256;
+		static constexpr size_t snippet_budget = 1 << 18;
+
 		std::vector<lexer_state> state;
-		std::istream& input;
+		std::vector<lexed_token> tokens;
+		std::vector<diagnostic> lex_diagnostics;
+		bool tokenized = false;
+		size_t index = 0;
+		size_t limit = (size_t)-1;
+		size_t reach = 0;
+		size_t scanned = 0;
+		size_t relexed_chars = 0;
+		std::vector<size_t> line_starts = { 0 };
+		size_t lines_scanned = 0;
+		// when streaming, the line table is packed instead, as varint line lengths
+		std::vector<line_block> line_blocks;
+		std::vector<unsigned char> line_lengths;
+		size_t line_count = 1;
+		size_t last_line_start = 0;
+		// when streaming, only [begin, end) of the input is held, starting at offset base
+		size_t block_size = 0;
+		std::istream* input = nullptr;
+		size_t base = 0;
+		// the locations the source was given; see place()
+		source_loc start_loc = 0;
+		size_t room = loc_space;
+		bool clipped = false;
+		// the runs of locations handed out to a parser, and how many of the source's locations
+		// they've used up; the open one starts at run_offset and so far reaches run_last
+		std::vector<loc_run> runs;
+		bool runs_sorted = true;
+		size_t used = 0;
+		size_t run_offset = 0;
+		size_t run_last = 0;
+		// lines that diagnostics point at, kept by line number once streamed past, and how far
+		// into diagnostics and lex_diagnostics they've been looked for
+		std::map<size_t, std::string> snippets;
+		size_t snippet_bytes = 0;
+		size_t noticed = 0;
+		size_t noticed_lex = 0;
+		std::string buffer;
+		const char* begin;
+		const char* cur;
+		const char* end;
 		std::vector<diagnostic>& diagnostics;
 		bool has_peeked = false;
 		token peeked;
@@ -50,31 +165,97 @@ namespace origin {
 		token ln_token;
 		bool has_ln;
 
+		token lex();
+		lexed_token lex_entry(std::vector<diagnostic>& into);
+		const token& push_token();
 		token next_internal();
-		token next_internal(bool, token);
+		void index_lines(size_t offset);
+		void add_line(size_t start);
+		size_t known_lines();
+		size_t line_start(size_t line);
+		void notice(const std::vector<diagnostic>& found, size_t& from, source_loc base);
+		void keep_line(size_t line);
+		void shift_lines(size_t offset, size_t removed, std::string_view inserted);
+		bool refill();
+		void clip();
+		void trim();
+		void append(lex_chunk& chunk, size_t from);
+
+		size_t offset_of(const char* at) {
+			return base + (size_t)(at - begin);
+		}
+		void replay();
+		token hand_out(const token& token);
 	public:
-		lexer(std::istream& input, std::vector<diagnostic>& diagnostics);
+		interner& names;
+		// added to offsets to give the locations of the tokens and diagnostics handed out now:
+		// where its source_manager placed the source, unless a parser has opened a run of its own
+		source_loc loc_base = 0;
+
+		lexer(std::string_view source, std::vector<diagnostic>& diagnostics, interner& names);
+		lexer(std::istream& input, std::vector<diagnostic>& diagnostics, interner& names);
+		lexer(std::istream& input, std::vector<diagnostic>& diagnostics, interner& names, size_t block_size);
+		std::string_view source();
+		bool streaming();
+		void place(source_loc base, size_t room);
+		source_loc first_loc();
+		size_t offset_at(source_loc loc);
+		void reset_runs(bool keep_used);
+		size_t room_left();
+		void open_run(size_t offset);
+		void close_run();
+		void keep_run(source_loc loc, size_t length, size_t offset);
+		size_t line_of(size_t offset);
+		size_t column_of(size_t offset);
+		std::string_view line(size_t line);
+		void tokenize();
+		void tokenize(size_t threads, size_t chunk_size = 1 << 20);
+		static void tokenize(const std::vector<lexer*>& lexers, size_t threads = 0);
+		size_t edit(size_t offset, size_t removed, std::string_view inserted);
+		size_t relexed();
+		size_t footprint();
 		bool eof();
 		bool is_next(token_type type);
-		bool is_next(token_type type, const std::string& value);
+		bool is_next(token_type type, atom value);
+		bool is_next(token_kind kind);
 		bool has_newline();
 		token newline_token();
-		bool try_to_close(token_type type, const std::string& open, const std::string& close);
+		bool try_to_close(token_kind open, token_kind close);
 		token last();
 		token next();
 		token peek();
 		token consume(token_type type);
-		token consume(token_type type, const std::string& value);
+		token consume(token_type type, atom value);
 		token consume_msg(token_type type, const std::string& message);
-		token consume_msg(token_type type, const std::string& value, const std::string& message);
+		token consume_msg(token_type type, atom value, const std::string& message);
+		token consume(token_kind kind);
+		token consume_msg(token_kind kind, const std::string& message);
 		token read(token_type type);
-		token read(token_type type, const std::string& value);
+		token read(token_type type, atom value);
 		token read_msg(token_type type, const std::string& message);
-		token read_msg(token_type type, const std::string& value, const std::string& message);
+		token read_msg(token_type type, atom value, const std::string& message);
+		token read(token_kind kind);
+		token read_msg(token_kind kind, const std::string& message);
 		void save();
 		void restore();
 		void discard();
+		bool can_seek();
+		size_t tell();
+		void seek(size_t position, size_t limit = (size_t)-1);
+		bool skip_braces(size_t* end = nullptr);
+		void reset_reach();
+		size_t reached();
+		token token_at(size_t position);
+		bool reported(size_t from, size_t to);
 	};
 
-	std::string encode_token(token token, bool include_value);
+	token_kind lookup_kind(std::string_view spelling);
+	// how the lexer skips whitespace, and a block comment from just after its "/*": a vector at
+	// a time where the target allows it, or with plain set, a character at a time as on other
+	// targets, so that the two can be checked against each other
+	const char* whitespace_end(const char* cur, const char* end, const char*& newline, bool plain = false);
+	const char* block_comment_end(const char* cur, const char* end, bool plain = false);
+	const char* spelling(token_kind kind);
+	std::string encode_token(token token, bool include_value, const interner& names);
+	uint64_t hash_source(std::string_view source);
 }
\ No newline at end of file
@@ -1,205 +1,146 @@
 #include "parser.h"
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <unordered_set>
 
 using namespace std::string_literals;
 
 namespace origin {
-	static void register_prefix_op(parser* parser,
-		std::unordered_map<std::string, prefix_parselet>& parselets,
-		std::unordered_map<std::string, int>& op_precedence, allocator& memory,
-		std::string op, int precedence) {
-		op_precedence["un" + op] = precedence;
-		parselets[op] = [&memory, op, parser](token start) {
-			auto result = memory.allocate<un_expr>();
-			result->op = op;
-			result->expr = parser->read_expr("un" + op);
-			result->start = start;
-			result->end = parser->lexer.last();
-			return result;
+	// dispatch for every symbol that can start or continue an expression, indexed by kind
+	const std::array<parser::parselets, token_kind_count> parser::operators = [] {
+		std::array<parselets, token_kind_count> table{};
+		auto prefix = [&](token_kind kind, int precedence, operation read) {
+			table[(size_t)kind].prefix = read;
+			table[(size_t)kind].prefix_precedence = precedence;
+		};
+		auto infix = [&](token_kind kind, int precedence, operation read, bool ltr = true) {
+			table[(size_t)kind].infix = read;
+			table[(size_t)kind].infix_precedence = precedence;
+			table[(size_t)kind].ltr = ltr;
 		};
+
+		//infix(token_kind::comma, 1, operation::binary);
+
+		infix(token_kind::assign, 2, operation::binary, false);
+		infix(token_kind::mul_assign, 2, operation::binary, false);
+		infix(token_kind::div_assign, 2, operation::binary, false);
+		infix(token_kind::mod_assign, 2, operation::binary, false);
+		infix(token_kind::add_assign, 2, operation::binary, false);
+		infix(token_kind::sub_assign, 2, operation::binary, false);
+		infix(token_kind::shl_assign, 2, operation::binary, false);
+		infix(token_kind::shr_assign, 2, operation::binary, false);
+		infix(token_kind::and_assign, 2, operation::binary, false);
+		infix(token_kind::or_assign, 2, operation::binary, false);
+		infix(token_kind::xor_assign, 2, operation::binary, false);
+
+		//infix(token_kind::question, 3, ...);
+		infix(token_kind::logical_or, 4, operation::binary);
+		infix(token_kind::logical_and, 5, operation::binary);
+		infix(token_kind::pipe, 6, operation::binary);
+		infix(token_kind::caret, 7, operation::binary);
+		infix(token_kind::ampersand, 8, operation::binary);
+
+		infix(token_kind::equal, 9, operation::binary);
+		infix(token_kind::not_equal, 9, operation::binary);
+
+		infix(token_kind::less_equal, 10, operation::binary);
+		infix(token_kind::greater_equal, 10, operation::binary);
+		infix(token_kind::less, 10, operation::binary);
+		infix(token_kind::greater, 10, operation::binary);
+
+		infix(token_kind::shl, 11, operation::binary);
+		infix(token_kind::shr, 11, operation::binary);
+
+		infix(token_kind::plus, 12, operation::binary);
+		infix(token_kind::minus, 12, operation::binary);
+
+		infix(token_kind::star, 13, operation::binary);
+		infix(token_kind::slash, 13, operation::binary);
+		infix(token_kind::percent, 13, operation::binary);
+
+		prefix(token_kind::increment, 14, operation::unary);
+		prefix(token_kind::decrement, 14, operation::unary);
+		prefix(token_kind::tilde, 14, operation::unary);
+		prefix(token_kind::bang, 14, operation::unary);
+		prefix(token_kind::minus, 14, operation::unary);
+		prefix(token_kind::plus, 14, operation::unary); // this is a useless operator
+
+		infix(token_kind::open_paren, 15, operation::call);
+		infix(token_kind::open_bracket, 15, operation::subscript);
+		infix(token_kind::dot, 15, operation::member);
+		infix(token_kind::scope, 16, operation::scope);
+
+		prefix(token_kind::open_paren, 17, operation::parenthetical);
+		return table;
+	}();
+
+	parser::parser(origin::lexer& lexer, std::vector<diagnostic>& diagnostics)
+		: arena(own_memory), memory(&own_memory), diagnostics(diagnostics), lexer(lexer) {
 	}
 
-	static void register_infix_op(parser* parser,
-		std::unordered_map<std::string, infix_parselet>& parselets,
-		std::unordered_map<std::string, int>& op_precedence, allocator& memory,
-		std::string op, int precedence, bool ltr) {
-		op_precedence[op] = precedence;
-		parselets[op] = [&memory, op, parser, precedence, ltr](token op_token, expr* left) {
-			auto result = memory.allocate<bin_expr>();
-			result->op = op;
-			result->left = left;
-			result->right = parser->read_expr(precedence - (ltr ? 0 : 1));
-			result->start = left->start;
-			result->op_token = op_token;
-			result->end = parser->lexer.last();
-			return result;
-		};
+	// parses into an arena that outlives the parser, such as one a long-running process resets
+	// between compilations
+	parser::parser(origin::lexer& lexer, std::vector<diagnostic>& diagnostics, allocator& memory)
+		: arena(memory), memory(&memory), diagnostics(diagnostics), lexer(lexer) {
 	}
 
-	parser::parser(origin::lexer& lexer, std::vector<diagnostic>& diagnostics)
-		: diagnostics(diagnostics), lexer(lexer) {
-		std::unordered_map<std::string, int> linfix_ops;
-		std::unordered_map<std::string, int> rinfix_ops;
-		std::unordered_map<std::string, int> prefix_ops;
-
-		//linfix_ops[","] = 1;
-
-		rinfix_ops["="] = 2;
-		rinfix_ops["*="] = 2;
-		rinfix_ops["/="] = 2;
-		rinfix_ops["%="] = 2;
-		rinfix_ops["+="] = 2;
-		rinfix_ops["-="] = 2;
-		rinfix_ops["<<~="] = 2;
-		rinfix_ops["~>>="] = 2;
-		rinfix_ops["&="] = 2;
-		rinfix_ops["|="] = 2;
-		rinfix_ops["^="] = 2;
-		
-		//linfix_ops["?"] = 3;
-		linfix_ops["||"] = 4;
-		linfix_ops["&&"] = 5;
-		linfix_ops["|"] = 6;
-		linfix_ops["^"] = 7;
-		linfix_ops["&"] = 8;
-
-		linfix_ops["=="] = 9;
-		linfix_ops["!="] = 9;
-
-		linfix_ops["<="] = 10;
-		linfix_ops[">="] = 10;
-		linfix_ops["<"] = 10;
-		linfix_ops[">"] = 10;
-
-		linfix_ops["<<~"] = 11;
-		linfix_ops["~>>"] = 11;
-
-		linfix_ops["+"] = 12;
-		linfix_ops["-"] = 12;
-
-		linfix_ops["*"] = 13;
-		linfix_ops["/"] = 13;
-		linfix_ops["%"] = 13;
-
-		prefix_ops["++"] = 14;
-		prefix_ops["--"] = 14;
-		prefix_ops["~"] = 14;
-		prefix_ops["!"] = 14;
-		prefix_ops["-"] = 14;
-		prefix_ops["+"] = 14; // this is a useless operator
-
-		//linfix_ops["::"] = 16;
-
-		for (auto curr : prefix_ops) {
-			register_prefix_op(this, prefix_parselets, op_precedence,
-				memory, curr.first, curr.second);
-		}
-
-		for (auto curr : linfix_ops) {
-			register_infix_op(this, infix_parselets, op_precedence,
-				memory, curr.first, curr.second, true);
-		}
-
-		for (auto curr : rinfix_ops) {
-			register_infix_op(this, infix_parselets, op_precedence,
-				memory, curr.first, curr.second, false);
-		}
-
-		op_precedence["("] = 15;
-		infix_parselets["("] = [&](token start, expr* left) {
-			auto result = memory.allocate<call_expr>();
-			result->start = left->start;
-			result->function = left;
-			while (!lexer.is_next(token_type::symbol, ")"s) && !lexer.eof()) {
-				result->args.push_back(read_expr());
-				if (lexer.is_next(token_type::symbol, ","s)) {
-					token comma = lexer.next();
-					if (lexer.is_next(token_type::symbol, ")"s)) {
-						diagnostics.push_back(error("trailing comma in argument list"s, comma));
-					}
-				}
-				else {
-					break;
-				}
-			}
-			if (!lexer.is_next(token_type::symbol, ")"s)
-				&& !lexer.try_to_close(token_type::symbol, "("s, ")"s)) {
-				diagnostics.push_back(error("unclosed function call"s, start));
-			}
-			lexer.read_msg(token_type::symbol, ")"s, "to close function call"s);
-			result->end = lexer.last();
-			return result;
-		};
+	// nodes this parser has made, counting bodies it read into the arena its nodes were
+	// handed over to
+	size_t parser::allocations() const {
+		return arena.allocations() + adopted_allocations;
+	}
 
-		op_precedence["["] = 15;
-		infix_parselets["["] = [&](token start, expr* left) {
-			auto result = memory.allocate<subscript>();
-			result->start = left->start;
-			result->left = left;
-			result->right = read_expr();
-			if (!lexer.is_next(token_type::symbol, "]"s)
-				&& !lexer.try_to_close(token_type::symbol, "["s, "]"s)) {
-				diagnostics.push_back(error("unclosed subscript"s, start));
-			}
-			lexer.read_msg(token_type::symbol, "]"s, "to close subscript"s);
-			result->end = lexer.last();
-			return result;
-		};
+	// gives the nodes parsed so far to a longer-lived arena; anything parsed after goes in the
+	// parser's arena as before, except for bodies read lazily, which go to the given arena to
+	// stay with the rest of their program; a parser already parsing into the given arena has
+	// nothing to give
+	void parser::hand_over(allocator& to) {
+		to.adopt(arena);
+		adopter = &to != &arena ? &to : nullptr;
+	}
 
-		op_precedence["."] = 15;
-		infix_parselets["."] = [&](token start, expr* left) {
-			auto result = memory.allocate<member>();
-			result->start = left->start;
-			result->object = left;
-			result->name = (result->name_token = lexer.consume(token_type::identifier)).value;
-			result->end = lexer.last();
-			return result;
-		};
+	// from the start of a node to the end of the token just read
+	source_range parser::to_last(source_range start) {
+		return span(start, range_of(lexer.last()));
+	}
 
-		op_precedence["::"] = 16;
-		infix_parselets["::"] = [&](token start, expr* left) {
-			auto result = memory.allocate<variable>();
-			auto ns = dynamic_cast<variable*>(left);
-			if (!ns) {
-				diagnostics.push_back(error("expected namespace"s, left->start, left->end));
-				ns = memory.allocate<variable>();
-				ns->name = "<error namespace>";
-			}
-			result->start = left->start;
-			result->name = ns->name + "::" + lexer.consume(token_type::identifier).value;
-			result->end = lexer.last();
-			return result;
-		};
+	expr* parser::read_member(token start, expr* left) {
+		auto result = memory->allocate<member>();
+		result->object = left;
+		token name = lexer.consume(token_type::identifier);
+		result->name = name.value;
+		result->name_range = range_of(name);
+		result->range = to_last(left->range);
+		return result;
+	}
 
-		op_precedence["un("] = 17;
-		prefix_parselets["("] = [&](token token) {
-			auto result = read_expr();
-			if (lexer.is_next(token_type::symbol, ")"s)) {
-				lexer.next();
-			}
-			else if (!lexer.try_to_close(token_type::symbol, "("s, ")"s)) {
-				diagnostics.push_back(error("unclosed parenthesis"s, token));
-				lexer.read_msg(token_type::symbol, ")"s, "to close parenthesis"s);
-			}
-			auto real_result = memory.allocate<parenthetical>();
-			real_result->expr = result;
-			real_result->start = token;
-			real_result->end = lexer.last();
-			return real_result;
-		};
+	expr* parser::read_scope(token start, expr* left) {
+		auto result = memory->allocate<variable>();
+		auto ns = dynamic_cast<variable*>(left);
+		if (!ns) {
+			diagnostics.push_back(error("expected namespace"s, left->range));
+			ns = memory->allocate<variable>();
+			ns->name = lexer.names.intern("<error namespace>");
+		}
+		result->name = lexer.names.intern(lexer.names.get(ns->name) + "::"
+			+ lexer.names.get(lexer.consume(token_type::identifier).value));
+		result->range = to_last(left->range);
+		return result;
 	}
 
-	static expr* atom(allocator& memory, lexer& lexer, std::vector<diagnostic>& diagnostics) {
+	static expr* primary(allocator& memory, lexer& lexer, std::vector<diagnostic>& diagnostics) {
 		if (lexer.is_next(token_type::number)) {
 			auto result = memory.allocate<int_literal>();
 			result->value = lexer.next().value;
-			result->end = result->start = lexer.last();
+			result->range = range_of(lexer.last());
 			return result;
 		}
 		else if (lexer.is_next(token_type::identifier)) {
 			auto result = memory.allocate<variable>();
 			result->name = lexer.next().value;
-			result->end = result->start = lexer.last();
+			result->range = range_of(lexer.last());
 			return result;
 		}
 		else {
@@ -208,17 +149,17 @@ namespace origin {
 	}
 
 	typing* parser::read_typing() {
-		auto result = memory.allocate<typing>();
-		result->start = lexer.peek();
-		result->alias_name = result->name = read_variable()->name;
-		if (lexer.is_next(token_type::symbol, "<"s)) {
+		auto result = memory->allocate<typing>();
+		result->range = range_of(lexer.peek());
+		result->alias_name = result->name = lexer.names.get(read_variable()->name);
+		if (lexer.is_next(token_kind::less)) {
 			token start = lexer.next();
-			result->generic_token = start;
+			result->generic_loc = loc_of(start);
 			while (lexer.is_next(token_type::identifier)) {
 				result->templates.push_back(read_typing());
-				if (lexer.is_next(token_type::symbol, ","s)) {
+				if (lexer.is_next(token_kind::comma)) {
 					token comma = lexer.next();
-					if (lexer.is_next(token_type::symbol, ">"s)) {
+					if (lexer.is_next(token_kind::greater)) {
 						diagnostics.push_back(error("trailing comma on template types"s, comma));
 					}
 				}
@@ -226,22 +167,21 @@ namespace origin {
 					break;
 				}
 			}
-			if (!lexer.is_next(token_type::symbol, ">"s)
-				&& !lexer.try_to_close(token_type::symbol, "<"s, ">"s)) {
+			if (!lexer.is_next(token_kind::greater)
+				&& !lexer.try_to_close(token_kind::less, token_kind::greater)) {
 				diagnostics.push_back(error("unclosed template"s, start));
 			}
-			lexer.read_msg(token_type::symbol, ">"s, "to close template"s);
+			lexer.read_msg(token_kind::greater, "to close template"s);
 		}
 		else {
-			result->generic_token = result->start;
-		}
-		result->end = lexer.last();
-		while (lexer.is_next(token_type::symbol, "["s)) {
-			auto array_result = memory.allocate<typing>();
-			array_result->generic_token = lexer.next();
-			lexer.read_msg(token_type::symbol, "]"s, "to close array modifier"s);
-			array_result->end = lexer.last();
-			array_result->start = result->start;
+			result->generic_loc = result->range.loc;
+		}
+		result->range = to_last(result->range);
+		while (lexer.is_next(token_kind::open_bracket)) {
+			auto array_result = memory->allocate<typing>();
+			array_result->generic_loc = loc_of(lexer.next());
+			lexer.read_msg(token_kind::close_bracket, "to close array modifier"s);
+			array_result->range = to_last(result->range);
 			array_result->alias_name = array_result->name = "stdlib::core::array";
 			array_result->templates.push_back(result);
 			result = array_result;
@@ -249,73 +189,172 @@ namespace origin {
 		return result;
 	}
 
-	expr* parser::read_expr(const std::string& op) {
-		int precedence = 0;
-		if (op_precedence.find(op) != op_precedence.end()) {
-			precedence = op_precedence[op];
-		}
-		return read_expr(precedence);
-	}
-
-	expr* parser::read_expr(int precedence) {
-		std::function<expr*()> fail = [&] {
-			return read_expr(precedence, fail);
-		};
-		return read_expr(precedence, fail);
-	}
-
-	expr* parser::read_expr(int precedence, std::function<expr*()> fail) {
-		expr* left = nullptr;
-		if (lexer.is_next(token_type::symbol)) {
-			token tok = lexer.peek();
-			if (prefix_parselets.find(tok.value) != prefix_parselets.end()) {
-				left = prefix_parselets[tok.value](lexer.next());
+	// reads an expression whose operators all bind tighter than precedence; rather than
+	// recursing for each operand, the operators and brackets waiting on one are pushed, and are
+	// built as soon as it's been read; a token that can't start an operand is reported and
+	// skipped, unless it's the first and or_nothing is set, in which case nothing is read
+	expr* parser::read_expr(int precedence, bool or_nothing) {
+		size_t base = pending.size();
+		expr* left;
+		while (true) {
+			const parselets& prefix = operators[(size_t)lexer.peek().kind];
+			if (prefix.prefix == operation::unary) {
+				token start = lexer.next();
+				auto result = memory->allocate<un_expr>();
+				result->op = lexer.names.get(start.value);
+				result->op_kind = start.kind;
+				pending.push_back({ operation::unary, precedence, start, result });
+				precedence = prefix.prefix_precedence;
+				continue;
+			}
+			else if (prefix.prefix == operation::parenthetical) {
+				pending.push_back({ operation::parenthetical, precedence, lexer.next(), nullptr });
+				precedence = -1;
+				continue;
 			}
-		}
 
-		if (left == nullptr) {
-			left = atom(memory, lexer, diagnostics);
+			left = primary(*memory, lexer, diagnostics);
+			if (left == nullptr) {
+				if (lexer.eof()) {
+					token tok = lexer.next();
+					diagnostics.push_back(error("unexpected <eof>"s, tok));
+					left = memory->allocate<error_expr>();
+				}
+				else {
+					token tok = lexer.next();
+					diagnostics.push_back(error("unexpected "s + encode_token(tok, true, lexer.names), tok));
+					if (or_nothing && pending.size() == base) return nullptr;
+					continue;
+				}
+			}
+			if (!read_operators(left, precedence, base)) return left;
 		}
+	}
 
+	// with an operand just read into left, reads the infix operators after it that bind tighter
+	// than precedence, and builds whatever was waiting on it; true when an operator or bracket
+	// that needs another operand has been pushed, and false when everything above base is done
+	bool parser::read_operators(expr*& left, int& precedence, size_t base) {
 		while (true) {
-			if (left == nullptr) break;
-			int tprec = -1;
-			if (lexer.is_next(token_type::symbol)) {
-				token tok = lexer.peek();
-				if (infix_parselets.find(tok.value) != infix_parselets.end()) {
-					int prec = op_precedence[tok.value];
-					if (prec > precedence) {
-						left = infix_parselets[tok.value](lexer.next(), left);
-						continue;
+			const parselets& op = operators[(size_t)lexer.peek().kind];
+			if (op.infix != operation::none && op.infix_precedence > precedence) {
+				token start = lexer.next();
+				if (op.infix == operation::member) {
+					left = read_member(start, left);
+				}
+				else if (op.infix == operation::scope) {
+					left = read_scope(start, left);
+				}
+				else if (op.infix == operation::binary) {
+					auto result = memory->allocate<bin_expr>();
+					result->op = lexer.names.get(start.value);
+					result->op_kind = start.kind;
+					result->left = left;
+					result->range = left->range;
+					result->op_range = range_of(start);
+					pending.push_back({ operation::binary, precedence, start, result });
+					precedence = op.infix_precedence - (op.ltr ? 0 : 1);
+					return true;
+				}
+				else if (op.infix == operation::call) {
+					auto result = memory->allocate<call_expr>();
+					result->range = left->range;
+					result->function = left;
+					if (!lexer.is_next(token_kind::close_paren) && !lexer.eof()) {
+						pending.push_back({ operation::call, precedence, start, result });
+						precedence = -1;
+						return true;
 					}
+					left = close_call(start, result);
+				}
+				else {
+					auto result = memory->allocate<subscript>();
+					result->range = left->range;
+					result->left = left;
+					pending.push_back({ operation::subscript, precedence, start, result });
+					precedence = -1;
+					return true;
 				}
+				continue;
 			}
-			break;
-		}
 
-		if (left == nullptr) {
-			if (lexer.eof()) {
-				token tok = lexer.next();
-				diagnostics.push_back(error("unexpected <eof>"s, tok));
-				return memory.allocate<error_expr>();
+			if (pending.size() == base) return false;
+			pending_operation waiting = pending.back();
+			pending.pop_back();
+			precedence = waiting.precedence;
+			if (waiting.kind == operation::unary) {
+				auto result = (un_expr*)waiting.node;
+				result->expr = left;
+				result->range = range_of(waiting.start, lexer.last());
+				left = result;
+			}
+			else if (waiting.kind == operation::parenthetical) {
+				if (lexer.is_next(token_kind::close_paren)) {
+					lexer.next();
+				}
+				else if (!lexer.try_to_close(token_kind::open_paren, token_kind::close_paren)) {
+					diagnostics.push_back(error("unclosed parenthesis"s, waiting.start));
+					lexer.read_msg(token_kind::close_paren, "to close parenthesis"s);
+				}
+				auto result = memory->allocate<parenthetical>();
+				result->expr = left;
+				result->range = range_of(waiting.start, lexer.last());
+				left = result;
+			}
+			else if (waiting.kind == operation::binary) {
+				auto result = (bin_expr*)waiting.node;
+				result->right = left;
+				result->range = to_last(result->range);
+				left = result;
+			}
+			else if (waiting.kind == operation::call) {
+				auto result = (call_expr*)waiting.node;
+				result->args.push_back(left);
+				if (lexer.is_next(token_kind::comma)) {
+					token comma = lexer.next();
+					if (lexer.is_next(token_kind::close_paren)) {
+						diagnostics.push_back(error("trailing comma in argument list"s, comma));
+					}
+					if (!lexer.is_next(token_kind::close_paren) && !lexer.eof()) {
+						pending.push_back(waiting);
+						precedence = -1;
+						return true;
+					}
+				}
+				left = close_call(waiting.start, result);
+			}
+			else {
+				auto result = (subscript*)waiting.node;
+				result->right = left;
+				if (!lexer.is_next(token_kind::close_bracket)
+					&& !lexer.try_to_close(token_kind::open_bracket, token_kind::close_bracket)) {
+					diagnostics.push_back(error("unclosed subscript"s, waiting.start));
+				}
+				lexer.read_msg(token_kind::close_bracket, "to close subscript"s);
+				result->range = to_last(result->range);
+				left = result;
 			}
-			token tok = lexer.next();
-			diagnostics.push_back(error("unexpected "s + encode_token(tok, true), tok));
-			return fail();
 		}
-		else {
-			return left;
+	}
+
+	expr* parser::close_call(token start, call_expr* call) {
+		if (!lexer.is_next(token_kind::close_paren)
+			&& !lexer.try_to_close(token_kind::open_paren, token_kind::close_paren)) {
+			diagnostics.push_back(error("unclosed function call"s, start));
 		}
+		lexer.read_msg(token_kind::close_paren, "to close function call"s);
+		call->range = to_last(call->range);
+		return call;
 	}
 
 	void parser::semi() {
-		if (!lexer.is_next(token_type::symbol, ";"s)) {
+		if (!lexer.is_next(token_kind::semicolon)) {
 			if (lexer.has_newline()) {
 				token newline = lexer.newline_token();
 				diagnostics.push_back(error("missing semicolon"s, newline));
 			}
 			else {
-				lexer.read_msg(token_type::symbol, ";"s, "to end statement"s);
+				lexer.read_msg(token_kind::semicolon, "to end statement"s);
 			}
 		}
 		else {
@@ -323,94 +362,250 @@ namespace origin {
 		}
 	}
 
+	// moves past the tokens read_typing() would read, without building anything
+	void parser::skip_typing() {
+		lexer.next();
+		while (lexer.is_next(token_kind::scope)) {
+			lexer.next();
+			lexer.next();
+		}
+		if (lexer.is_next(token_kind::less)) {
+			lexer.next();
+			while (lexer.is_next(token_type::identifier)) {
+				skip_typing();
+				if (lexer.is_next(token_kind::comma)) {
+					lexer.next();
+				}
+				else {
+					break;
+				}
+			}
+			if (!lexer.is_next(token_kind::greater)) {
+				lexer.try_to_close(token_kind::less, token_kind::greater);
+			}
+			if (lexer.is_next(token_kind::greater)) {
+				lexer.next();
+			}
+		}
+		while (lexer.is_next(token_kind::open_bracket)) {
+			lexer.next();
+			if (lexer.is_next(token_kind::close_bracket)) {
+				lexer.next();
+			}
+		}
+	}
+
+	// a statement is a declaration when it starts with a typing that's followed by a name
+	bool parser::is_vardecl_next() {
+		lexer.save();
+		skip_typing();
+		bool result = lexer.is_next(token_type::identifier);
+		lexer.restore();
+		return result;
+	}
+
 	variable* parser::read_variable() {
-		auto varv = memory.allocate<variable>();
-		varv->start = lexer.peek();
+		auto varv = memory->allocate<variable>();
+		varv->range = range_of(lexer.peek());
 		varv->name = lexer.consume(token_type::identifier).value;
-		while (lexer.is_next(token_type::symbol, "::"s)) {
+		while (lexer.is_next(token_kind::scope)) {
 			lexer.next();
-			varv->name += "::" + lexer.consume(token_type::identifier).value;
+			varv->name = lexer.names.intern(lexer.names.get(varv->name) + "::"
+				+ lexer.names.get(lexer.consume(token_type::identifier).value));
 		}
-		varv->end = lexer.last();
+		varv->range = to_last(varv->range);
 		return varv;
 	}
 
 	stat* parser::read_stat() {
-		if (lexer.is_next(token_type::keyword, "return"s)) {
-			auto result = memory.allocate<return_stat>();
-			result->start = lexer.peek();
-			lexer.next();
-			result->expr = read_expr();
-			semi();
-			result->end = lexer.last();
-			return result;
-		}
-		else if (lexer.is_next(token_type::keyword, "do"s)) {
-			token start = lexer.next();
-			auto result = read_block();
-			result->start = start;
-			return result;
-		}
-		else {
-			lexer.save();
-			token begin = lexer.peek();
-			if (lexer.is_next(token_type::identifier)) {
-				typing* typing = read_typing();
-				if (lexer.is_next(token_type::identifier)) {
-					lexer.restore();
+		// a token that can't start a statement is reported and skipped, until one that can
+		while (true) {
+			if (lexer.is_next(token_kind::return_keyword)) {
+				auto result = memory->allocate<return_stat>();
+				result->range = range_of(lexer.next());
+				result->expr = read_expr();
+				semi();
+				result->range = to_last(result->range);
+				return result;
+			}
+			else if (lexer.is_next(token_kind::do_keyword)) {
+				token start = lexer.next();
+				auto result = read_block();
+				result->range = span(range_of(start), result->range);
+				return result;
+			}
+			else {
+				if (lexer.is_next(token_type::identifier) && is_vardecl_next()) {
 					return read_vardecl();
 				}
-				else {
-					lexer.restore();
-				}
+				expr* expr = read_expr(0, true);
+				if (expr == nullptr) continue;
+				semi();
+				auto result = memory->allocate<expr_stat>();
+				result->range = expr->range;
+				result->expr = expr;
+				return result;
 			}
-			expr* expr = read_expr(0, [] {
-				return nullptr;
-			});
-			if (expr == nullptr) return read_stat();
-			semi();
-			auto result = memory.allocate<expr_stat>();
-			result->start = expr->start;
-			result->end = expr->end;
-			result->expr = expr;
-			return result;
 		}
 	}
 
 	block* parser::read_block() {
-		auto result = memory.allocate<block>();
-		token start = lexer.read_msg(token_type::symbol, "{"s, "to open block"s);
-		result->start = start;
-		while (lexer.is_next(token_type::symbol, ";"s)) lexer.next();
-		while (!lexer.is_next(token_type::symbol, "}"s) && !lexer.eof()) {
+		auto result = memory->allocate<block>();
+		token start = lexer.read_msg(token_kind::open_brace, "to open block"s);
+		result->range = range_of(start);
+		while (lexer.is_next(token_kind::semicolon)) lexer.next();
+		while (!lexer.is_next(token_kind::close_brace) && !lexer.eof()) {
 			result->stats.push_back(read_stat());
-			while (lexer.is_next(token_type::symbol, ";"s)) lexer.next();
+			while (lexer.is_next(token_kind::semicolon)) lexer.next();
 		}
-		if (!lexer.is_next(token_type::symbol, "}"s)) {
-			diagnostics.push_back(error("unclosed block"s, result->start));
+		if (!lexer.is_next(token_kind::close_brace)) {
+			diagnostics.push_back(error("unclosed block"s, start));
 		}
-		lexer.read_msg(token_type::symbol, "}"s, "to close block"s);
-		result->end = lexer.last();
+		lexer.read_msg(token_kind::close_brace, "to close block"s);
+		result->range = to_last(result->range);
 		return result;
 	}
 
+	// parses the block between two positions from lexer.tell(), then puts the cursor back
+	block* parser::read_block_at(size_t position, size_t end) {
+		memory_phase_scope phase(memory_phase::parse);
+		size_t back = lexer.tell();
+		lexer.seek(position, end);
+		block* result = read_block();
+		lexer.seek(back);
+		return result;
+	}
+
+	// reads a lazily read body from wherever its declaration is now, with the locations the
+	// declaration was given
+	block* parser::read_body_at(size_t body) {
+		body_range range = body_ranges[body];
+		place at = places[range.place];
+		source_loc back = lexer.loc_base;
+		size_t back_place = current_place;
+		allocator* back_memory = memory;
+		lexer.loc_base = at.loc - (source_loc)at.start;
+		current_place = range.place;
+		if (adopter != nullptr) memory = adopter;
+		size_t before = memory->allocations();
+		block* result = read_block_at(at.position + range.position, at.position + range.end);
+		if (adopter != nullptr) adopted_allocations += memory->allocations() - before;
+		memory = back_memory;
+		lexer.loc_base = back;
+		current_place = back_place;
+		return result;
+	}
+
+	// with lazy_bodies set, a function body is skipped by matching braces, and only parsed
+	// once something asks for lambda::body()
+	block* parser::read_body(lambda* lambda) {
+		if (lazy_bodies && lexer.can_seek()) {
+			size_t position = lexer.tell(), end;
+			lexer.save();
+			if (lexer.skip_braces(&end) && can_defer(position, end)) {
+				lexer.discard();
+				size_t body = body_ranges.size();
+				size_t from = places[current_place].position;
+				body_ranges.push_back({ current_place, position - from, end - from });
+				lambda->read_block = [this, body, parser = std::weak_ptr<bool>(alive)] {
+					assert(!parser.expired() && "a body was read after the parser that skipped it was gone");
+					return read_body_at(body);
+				};
+				return nullptr;
+			}
+			lexer.restore();
+		}
+		return read_block();
+	}
+
+	// whether a body that was skipped over can be left for later without its errors going
+	// unreported until then, as far as that can be told without parsing it: lexing it gave no
+	// diagnostics, its brackets pair up, no operator that needs a left operand comes where an
+	// expression would start, and no binary operator is left without a right one; > and >>
+	// aren't held to that, since they also close template types
+	bool parser::can_defer(size_t position, size_t end) {
+		if (lexer.reported(position, end)) return false;
+		std::vector<token_kind> open;
+		token previous = {};
+		for (size_t i = position; i < end; ++i) {
+			token token = lexer.token_at(i);
+			switch (token.kind) {
+			case token_kind::open_paren:
+			case token_kind::open_bracket:
+			case token_kind::open_brace:
+				open.push_back(token.kind);
+				break;
+			case token_kind::close_paren:
+			case token_kind::close_bracket:
+			case token_kind::close_brace: {
+				token_kind opener = token.kind == token_kind::close_paren ? token_kind::open_paren
+					: token.kind == token_kind::close_bracket ? token_kind::open_bracket : token_kind::open_brace;
+				if (open.empty() || open.back() != opener) return false;
+				open.pop_back();
+				break;
+			}
+			default:
+				break;
+			}
+			const parselets& before = operators[(size_t)previous.kind];
+			if ((before.infix == operation::binary || before.infix == operation::member
+				|| before.infix == operation::scope) && previous.kind != token_kind::greater
+				&& previous.kind != token_kind::shr) {
+				switch (token.kind) {
+				case token_kind::close_paren:
+				case token_kind::close_bracket:
+				case token_kind::close_brace:
+				case token_kind::semicolon:
+				case token_kind::comma:
+					return false;
+				default:
+					break;
+				}
+			}
+			const parselets& entry = operators[(size_t)token.kind];
+			if (entry.infix != operation::none && entry.prefix == operation::none) {
+				switch (previous.kind) {
+				case token_kind::open_paren:
+				case token_kind::open_bracket:
+				case token_kind::open_brace:
+				case token_kind::close_brace:
+				case token_kind::semicolon:
+				case token_kind::comma:
+					return false;
+				default:
+					if (previous.type == token_type::keyword && previous.kind != token_kind::true_keyword
+						&& previous.kind != token_kind::false_keyword) {
+						return false;
+					}
+				}
+			}
+			previous = token;
+		}
+		return open.empty();
+	}
+
 	vardecl* parser::read_vardecl() {
-		auto result = memory.allocate<vardecl>();
-		result->start = lexer.peek();
-		result->typing = read_typing();
-		result->var_token = lexer.read(token_type::identifier);
-		result->variable = result->var_token.value;
-		if (lexer.is_next(token_type::symbol, "("s)) {
-			auto lambda = memory.allocate<origin::lambda>();
-			lambda->start = result->start;
+		return read_vardecl(read_typing());
+	}
+
+	vardecl* parser::read_vardecl(typing* typing) {
+		auto result = memory->allocate<vardecl>();
+		result->range = typing->range;
+		result->typing = typing;
+		token name = lexer.read(token_type::identifier);
+		result->var_range = range_of(name);
+		result->variable = name.value;
+		if (lexer.is_next(token_kind::open_paren)) {
+			auto lambda = memory->allocate<origin::lambda>();
+			lambda->range = result->range;
 
 			token start = lexer.next();
-			while (!lexer.is_next(token_type::symbol, ")"s) && !lexer.eof()) {
+			while (!lexer.is_next(token_kind::close_paren) && !lexer.eof()) {
 				lambda->param_types.push_back(read_typing());
 				lambda->param_names.push_back(lexer.consume(token_type::identifier).value);
-				if (lexer.is_next(token_type::symbol, ","s)) {
+				if (lexer.is_next(token_kind::comma)) {
 					token comma = lexer.next();
-					if (lexer.is_next(token_type::symbol, ")"s)) {
+					if (lexer.is_next(token_kind::close_paren)) {
 						diagnostics.push_back(error("trailing comma in parameter list"s, comma));
 					}
 				}
@@ -418,29 +613,28 @@ namespace origin {
 					break;
 				}
 			}
-			if (lexer.is_next(token_type::symbol, ")"s)) {
+			if (lexer.is_next(token_kind::close_paren)) {
 				lexer.next();
 			}
-			else if (!lexer.try_to_close(token_type::symbol, "("s, ")"s)) {
+			else if (!lexer.try_to_close(token_kind::open_paren, token_kind::close_paren)) {
 				diagnostics.push_back(error("unclosed parenthesis"s, start));
-				lexer.read_msg(token_type::symbol, ")"s, "to close parenthesis"s);
+				lexer.read_msg(token_kind::close_paren, "to close parenthesis"s);
 			}
 			token tend = lexer.last();
 			lambda->return_type = result->typing;
-			lambda->block = read_block();
-			lambda->end = lexer.last();
+			lambda->block = read_body(lambda);
+			lambda->range = to_last(lambda->range);
 			result->init_value = lambda;
-			result->typing = memory.allocate<typing>();
-			result->typing->start = lambda->return_type->start;
-			result->typing->generic_token = lambda->return_type->start;
-			result->typing->end = tend;
+			result->typing = memory->allocate<origin::typing>();
+			result->typing->range = span(lambda->return_type->range, range_of(tend));
+			result->typing->generic_loc = lambda->return_type->range.loc;
 			result->typing->alias_name = result->typing->name = "stdlib::core::function";
 			result->typing->templates.push_back(lambda->return_type);
 			for (auto type : lambda->param_types) {
 				result->typing->templates.push_back(type);
 			}
 		}
-		else if (lexer.is_next(token_type::symbol, "="s)) {
+		else if (lexer.is_next(token_kind::assign)) {
 			lexer.next();
 			result->init_value = read_expr();
 			semi();
@@ -448,21 +642,20 @@ namespace origin {
 		else {
 			semi();
 		}
-		result->end = lexer.last();
+		result->range = to_last(result->range);
 		return result;
 	}
 
 	lambda* parser::read_func_part(typing* return_type) {
-		auto lambda = memory.allocate<origin::lambda>();
-		lambda->start = lexer.peek();
-
-		token start = lexer.consume(token_type::symbol, "("s);
-		while (!lexer.is_next(token_type::symbol, ")"s) && !lexer.eof()) {
+		auto lambda = memory->allocate<origin::lambda>();
+		lambda->range = range_of(lexer.peek());
+		token start = lexer.consume(token_kind::open_paren);
+		while (!lexer.is_next(token_kind::close_paren) && !lexer.eof()) {
 			lambda->param_types.push_back(read_typing());
 			lambda->param_names.push_back(lexer.consume(token_type::identifier).value);
-			if (lexer.is_next(token_type::symbol, ","s)) {
+			if (lexer.is_next(token_kind::comma)) {
 				token comma = lexer.next();
-				if (lexer.is_next(token_type::symbol, ")"s)) {
+				if (lexer.is_next(token_kind::close_paren)) {
 					diagnostics.push_back(error("trailing comma in parameter list"s, comma));
 				}
 			}
@@ -470,19 +663,19 @@ namespace origin {
 				break;
 			}
 		}
-		if (lexer.is_next(token_type::symbol, ")"s)) {
+		if (lexer.is_next(token_kind::close_paren)) {
 			lexer.next();
 		}
-		else if (!lexer.try_to_close(token_type::symbol, "("s, ")"s)) {
+		else if (!lexer.try_to_close(token_kind::open_paren, token_kind::close_paren)) {
 			diagnostics.push_back(error("unclosed parenthesis"s, start));
-			lexer.read_msg(token_type::symbol, ")"s, "to close parenthesis"s);
+			lexer.read_msg(token_kind::close_paren, "to close parenthesis"s);
 		}
 
 		lambda->return_type = return_type;
-		lambda->block = read_block();
-		lambda->end = lexer.last();
+		lambda->block = read_body(lambda);
+		lambda->range = to_last(lambda->range);
 
-		auto typing = memory.allocate<origin::typing>();
+		auto typing = memory->allocate<origin::typing>();
 		typing->alias_name = typing->name = "stdlib::core::function";
 		typing->templates.push_back(lambda->return_type);
 		for (auto type : lambda->param_types) {
@@ -493,22 +686,24 @@ namespace origin {
 	}
 
 	classdef* parser::read_classdef() {
-		auto result = memory.allocate<classdef>();
-		result->is_struct = lexer.is_next(token_type::keyword, "struct"s);
+		auto result = memory->allocate<classdef>();
+		result->is_struct = lexer.is_next(token_kind::struct_keyword);
 		lexer.next();
-		result->name = (result->name_token = lexer.consume(token_type::identifier)).value;
-		if (lexer.is_next(token_type::symbol, "<"s)) {
+		token name = lexer.consume(token_type::identifier);
+		result->name = name.value;
+		result->name_range = range_of(name);
+		if (lexer.is_next(token_kind::less)) {
 			token start = lexer.next();
 			while (lexer.is_next(token_type::identifier)) {
-				result->generics.push_back(lexer.next().value);
-				if (lexer.is_next(token_type::symbol, "..."s)) {
+				result->generics.push_back(lexer.names.get(lexer.next().value));
+				if (lexer.is_next(token_kind::ellipsis)) {
 					lexer.next();
 					result->variadic = true;
 					break;
 				}
-				if (lexer.is_next(token_type::symbol, ","s)) {
+				if (lexer.is_next(token_kind::comma)) {
 					token comma = lexer.next();
-					if (lexer.is_next(token_type::symbol, ">"s)) {
+					if (lexer.is_next(token_kind::greater)) {
 						diagnostics.push_back(error("trailing comma on template types"s, comma));
 					}
 				}
@@ -516,49 +711,48 @@ namespace origin {
 					break;
 				}
 			}
-			if (!lexer.is_next(token_type::symbol, ">"s)
-				&& !lexer.try_to_close(token_type::symbol, "<"s, ">"s)) {
+			if (!lexer.is_next(token_kind::greater)
+				&& !lexer.try_to_close(token_kind::less, token_kind::greater)) {
 				diagnostics.push_back(error("unclosed template"s, start));
 			}
-			lexer.read_msg(token_type::symbol, ">"s, "to close template"s);
+			lexer.read_msg(token_kind::greater, "to close template"s);
 		}
 		access current_access = access::private_access;
-		token start = lexer.read_msg(token_type::symbol, "{"s, "to open class definition"s);
-		while (!lexer.is_next(token_type::symbol, "}"s) && !lexer.eof()) {
-			if (lexer.is_next(token_type::keyword, "private"s)) {
+		token start = lexer.read_msg(token_kind::open_brace, "to open class definition"s);
+		while (!lexer.is_next(token_kind::close_brace) && !lexer.eof()) {
+			if (lexer.is_next(token_kind::private_keyword)) {
 				lexer.next();
-				lexer.read_msg(token_type::symbol, ":"s, "after access modifier"s);
+				lexer.read_msg(token_kind::colon, "after access modifier"s);
 				current_access = access::private_access;
 			}
-			else if (lexer.is_next(token_type::keyword, "public"s)) {
+			else if (lexer.is_next(token_kind::public_keyword)) {
 				lexer.next();
-				lexer.read_msg(token_type::symbol, ":"s, "after access modifier"s);
+				lexer.read_msg(token_kind::colon, "after access modifier"s);
 				current_access = access::public_access;
 			}
-			else if (lexer.is_next(token_type::symbol, "~"s)) {
-				auto vardecl = memory.allocate<origin::vardecl>();
-				vardecl->start = lexer.peek();
-				lexer.next();
+			else if (lexer.is_next(token_kind::tilde)) {
+				auto vardecl = memory->allocate<origin::vardecl>();
+				vardecl->range = range_of(lexer.next());
 				lexer.read_msg(token_type::identifier, result->name, "in destructor"s);
-				vardecl->variable = ".dtor";
+				vardecl->variable = lexer.names.intern(".dtor");
 				lambda* lambda = read_func_part(nullptr);
 				vardecl->init_value = lambda;
-				vardecl->end = lexer.last();
+				vardecl->range = to_last(vardecl->range);
 				result->vardecls.push_back(vardecl);
 				result->accesses.push_back(current_access);
 			}
 			else {
-				lexer.save();
 				if (lexer.is_next(token_type::identifier, result->name)) {
-					auto vardecl = memory.allocate<origin::vardecl>();
-					vardecl->start = lexer.peek();
-					lexer.next();
-					if (lexer.is_next(token_type::symbol, "("s)) {
+					lexer.save();
+					token start = lexer.next();
+					if (lexer.is_next(token_kind::open_paren)) {
 						lexer.discard();
-						vardecl->variable = ".ctor";
+						auto vardecl = memory->allocate<origin::vardecl>();
+						vardecl->range = range_of(start);
+						vardecl->variable = lexer.names.intern(".ctor");
 						lambda* lambda = read_func_part(nullptr);
 						vardecl->init_value = lambda;
-						vardecl->end = lexer.last();
+						vardecl->range = to_last(vardecl->range);
 						result->vardecls.push_back(vardecl);
 						result->accesses.push_back(current_access);
 						continue;
@@ -567,27 +761,24 @@ namespace origin {
 						lexer.restore();
 					}
 				}
-				lexer.save();
 				typing* typing = read_typing();
-				if (lexer.is_next(token_type::keyword, "operator"s)) {
-					lexer.discard();
-					auto vardecl = memory.allocate<origin::vardecl>();
-					vardecl->start = lexer.peek();
-					lexer.next();
+				if (lexer.is_next(token_kind::operator_keyword)) {
+					auto vardecl = memory->allocate<origin::vardecl>();
+					vardecl->range = range_of(lexer.next());
 					token sym1 = lexer.consume(token_type::symbol);
-					std::string op = sym1.value;
-					if (sym1.value == "("s) {
-						lexer.read_msg(token_type::symbol, ")"s, "to close parenthesis"s);
+					std::string op = lexer.names.get(sym1.value);
+					if (sym1.kind == token_kind::open_paren) {
+						lexer.read_msg(token_kind::close_paren, "to close parenthesis"s);
 					}
-					else if (sym1.value == "["s) {
-						lexer.read_msg(token_type::symbol, "]"s, "to close bracket"s);
-						if (lexer.is_next(token_type::symbol, "="s)) {
+					else if (sym1.kind == token_kind::open_bracket) {
+						lexer.read_msg(token_kind::close_bracket, "to close bracket"s);
+						if (lexer.is_next(token_kind::assign)) {
 							lexer.next();
 							op += "=";
 						}
 					}
-					bool can_override = infix_parselets.find(op) != infix_parselets.end()
-						|| prefix_parselets.find(op) != prefix_parselets.end()
+					bool can_override = operators[(size_t)sym1.kind].infix != operation::none
+						|| operators[(size_t)sym1.kind].prefix != operation::none
 						|| op == "[=" || op == "<=>";
 					std::unordered_set<std::string> no_list;
 					no_list.insert("=");
@@ -615,66 +806,230 @@ namespace origin {
 					no_list.insert("++");
 					no_list.insert("--");
 					if (!can_override || no_list.find(op) != no_list.end()) {
-						diagnostics.push_back(error("cannot override operator"s,
-							vardecl->start, lexer.last()));
+						diagnostics.push_back(error("cannot override operator"s, to_last(vardecl->range)));
 					}
-					vardecl->variable = "operator"s + op;
+					vardecl->variable = lexer.names.intern("operator"s + op);
 					lambda* lambda = read_func_part(typing);
 					// should I maybe check that the parameters the operators take in are valid?
 					// maybe just warn about it, but not enforce it
 					vardecl->init_value = lambda;
 					vardecl->typing = lambda->typing;
-					vardecl->end = lexer.last();
+					vardecl->range = to_last(vardecl->range);
 					result->vardecls.push_back(vardecl);
 					result->accesses.push_back(current_access);
 				}
 				else {
-					lexer.restore();
-					result->vardecls.push_back(read_vardecl());
+					result->vardecls.push_back(read_vardecl(typing));
 					result->accesses.push_back(current_access);
 				}
 			}
 		}
-		if (!lexer.is_next(token_type::symbol, "}"s)) {
+		if (!lexer.is_next(token_kind::close_brace)) {
 			diagnostics.push_back(error("unclosed class definition"s, start));
 		}
-		lexer.read_msg(token_type::symbol, "}"s, "to close class definition"s);
+		lexer.read_msg(token_kind::close_brace, "to close class definition"s);
 		return result;
 	}
 
-	program* parser::read_program() {
-		auto result = memory.allocate<program>();
-		if (lexer.is_next(token_type::keyword, "namespace"s)) {
+	void parser::read_header(program* result) {
+		if (lexer.is_next(token_kind::namespace_keyword)) {
 			lexer.next();
-			result->namespace_name = read_variable()->name;
+			result->namespace_name = lexer.names.get(read_variable()->name);
 			semi();
 		}
-		while (lexer.is_next(token_type::keyword, "import"s)) {
+		while (lexer.is_next(token_kind::import_keyword)) {
 			lexer.next();
 			result->imports.push_back(read_variable());
 			semi();
 		}
+	}
+
+	// reads one top-level declaration into result, and notes where it came from when the
+	// lexer can seek
+	void parser::read_declaration(program* result) {
+		declaration entry;
+		bool seekable = lexer.can_seek();
+		if (seekable) {
+			entry.position = lexer.tell();
+			token first = lexer.peek();
+			entry.start = first.start;
+			entry.loc = loc_of(first);
+			entry.place = current_place = places.size();
+			places.push_back({ entry.position, entry.start, entry.loc });
+			lexer.reset_reach();
+		}
+		size_t first_diagnostic = diagnostics.size();
+		if (lexer.is_next(token_kind::class_keyword)) {
+			result->classes.push_back(entry.classdef = read_classdef());
+		}
+		else if (lexer.is_next(token_kind::struct_keyword)) {
+			result->classes.push_back(entry.classdef = read_classdef());
+		}
+		else if (lexer.is_next(token_kind::alias_keyword)) {
+			lexer.next();
+			auto name = lexer.names.get(lexer.consume_msg(token_type::identifier, "in type alias"s).value);
+			lexer.read(token_kind::assign);
+			auto typing = read_typing();
+			semi();
+			result->typedefs[name] = typing;
+			entry.alias_name = name;
+			entry.alias = typing;
+		}
+		else if (lexer.is_next(token_type::identifier)) {
+			result->vardecls.push_back(entry.vardecl = read_vardecl());
+		}
+		else {
+			lexer.consume(token_type::identifier);
+			return;
+		}
+		if (!seekable) return;
+		entry.end = lexer.tell();
+		entry.reach = std::max(lexer.reached(), entry.end);
+		entry.reach_token = lexer.token_at(entry.reach);
+		entry.length = std::min(entry.reach_token.end + 1, lexer.source().size()) - entry.start;
+		entry.hash = hash_source(lexer.source().substr(entry.start, entry.length));
+		entry.diagnostics.assign(diagnostics.begin() + first_diagnostic, diagnostics.end());
+		result->declarations.push_back(std::move(entry));
+	}
+
+	program* parser::read_program() {
+		memory_phase_scope phase(memory_phase::parse);
+		auto result = memory->allocate<program>();
+		result->base = lexer.first_loc();
+		bool seekable = lexer.can_seek();
+		if (seekable) {
+			lexer.reset_runs(false);
+			lexer.open_run(0);
+		}
+		read_header(result);
 		while (!lexer.eof()) {
-			if (lexer.is_next(token_type::keyword, "class"s)) {
-				result->classes.push_back(read_classdef());
-			}
-			else if (lexer.is_next(token_type::keyword, "struct"s)) {
-				result->classes.push_back(read_classdef());
-			}
-			else if (lexer.is_next(token_type::keyword, "alias"s)) {
-				lexer.next();
-				auto name = lexer.consume_msg(token_type::identifier, "in type alias"s).value;
-				lexer.read(token_type::symbol, "="s);
-				auto typing = read_typing();
-				semi();
-				result->typedefs[name] = typing;
+			read_declaration(result);
+		}
+		if (seekable) lexer.close_run();
+		return result;
+	}
+
+	// takes a declaration read before an edit if it's at the cursor now and the edit can't have
+	// changed it: the source from its start to the end of the furthest token it depended on is
+	// the same, either by lying wholly on one side of the edit or by hashing the same, and that
+	// token is still where it was; it's moved over, keeping its locations, and the cursor goes
+	// past it, into a run of locations of its own
+	bool parser::reuse(program* result, declaration& old, size_t offset, size_t removed) {
+		size_t position = lexer.tell();
+		size_t start = lexer.peek().start;
+		ptrdiff_t delta = (ptrdiff_t)start - (ptrdiff_t)old.start;
+		bool untouched = old.start + old.length <= offset || old.start >= offset + removed;
+		if (!untouched && (start + old.length > lexer.source().size()
+			|| hash_source(lexer.source().substr(start, old.length)) != old.hash)) {
+			return false;
+		}
+		token reach = lexer.token_at(position + (old.reach - old.position));
+		if (reach.type != old.reach_token.type || reach.start != old.reach_token.start + delta
+			|| reach.end != old.reach_token.end + delta) {
+			return false;
+		}
+
+		ptrdiff_t moved = (ptrdiff_t)position - (ptrdiff_t)old.position;
+		declaration entry = std::move(old);
+		lexer.close_run();
+		lexer.keep_run(entry.loc, entry.reach_token.end + 1 - entry.start, start);
+		entry.position = position;
+		entry.end += moved;
+		entry.reach += moved;
+		entry.start = start;
+		entry.reach_token = reach;
+		places[entry.place] = { position, start, entry.loc };
+		diagnostics.insert(diagnostics.end(), entry.diagnostics.begin(), entry.diagnostics.end());
+		if (entry.classdef != nullptr) result->classes.push_back(entry.classdef);
+		if (entry.vardecl != nullptr) result->vardecls.push_back(entry.vardecl);
+		if (entry.alias != nullptr) result->typedefs[entry.alias_name] = entry.alias;
+		lexer.open_run(lexer.token_at(entry.end - 1).end + 1);
+		lexer.seek(entry.end);
+		result->declarations.push_back(std::move(entry));
+		return true;
+	}
+
+	// applies an edit to the source and reads the program again, reading only the declarations
+	// the edit could have changed and taking the rest from previous, so that the work done is
+	// about the size of what was edited rather than of the file; previous must have been read by
+	// this parser, and not been through the type assigner, whose patches it would carry over,
+	// and its declarations are moved out of it
+	//
+	// what's read afresh is given runs of locations the source hasn't handed out before, while
+	// the declarations taken keep theirs, so that taking one costs the same however far it has
+	// moved; the lexer turns locations back into offsets by the runs (see lexer::offset_at);
+	// once the source has too few locations left for a run over all of it, it's read whole
+	program* parser::reparse(program* previous, size_t offset, size_t removed, std::string_view inserted) {
+		memory_phase_scope phase(memory_phase::parse);
+		lexer.edit(offset, removed, inserted);
+		if (!lexer.can_seek() || lexer.room_left() <= lexer.source().size()) return read_program();
+		lexer.reset_runs(true);
+		lexer.open_run(0);
+		auto result = memory->allocate<program>();
+		result->base = lexer.first_loc();
+		read_header(result);
+		ptrdiff_t delta = (ptrdiff_t)inserted.size() - (ptrdiff_t)removed;
+		auto old = previous->declarations.begin();
+		while (!lexer.eof()) {
+			size_t start = lexer.peek().start;
+			// declarations are passed over once the cursor is beyond where they'd now start, or
+			// if they started inside what was removed
+			while (old != previous->declarations.end()) {
+				if (old->start >= offset + removed && old->start + delta >= start) break;
+				if (old->start < offset && old->start >= start) break;
+				++old;
 			}
-			else if (lexer.is_next(token_type::identifier)) {
-				result->vardecls.push_back(read_vardecl());
+			if (old != previous->declarations.end()
+				&& (old->start < offset ? old->start : old->start + delta) == start
+				&& reuse(result, *old, offset, removed)) {
+				++old;
+				continue;
 			}
-			else {
-				lexer.consume(token_type::identifier);
+			read_declaration(result);
+		}
+		lexer.close_run();
+		return result;
+	}
+
+	// reads a program from each parser, spreading them over the threads (one per core for 0);
+	// every parser has an arena and a diagnostics buffer of its own, and its lexer shares only
+	// the interner with the others; the buffers are moved into diagnostics in the order given
+	// once all have been read, so the results are just as if they were read one after another;
+	// each program's nodes are handed over to memory as soon as it's read, and bodies it parses
+	// lazily later on go there too, though reading them still takes the parser and its lexer
+	std::vector<program*> parser::read_programs(const std::vector<parser*>& parsers,
+		std::vector<diagnostic>& diagnostics, allocator& memory, size_t threads) {
+		if (threads == 0) {
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		std::vector<origin::lexer*> lexers;
+		for (parser* parser : parsers) {
+			lexers.push_back(&parser->lexer);
+		}
+		origin::lexer::tokenize(lexers, threads);
+
+		std::vector<program*> result(parsers.size());
+		std::atomic<size_t> next_parser = 0;
+		auto work = [&]() {
+			for (size_t i; (i = next_parser++) < parsers.size();) {
+				result[i] = parsers[i]->read_program();
+				parsers[i]->hand_over(memory);
 			}
+		};
+		std::vector<std::thread> pool;
+		for (size_t i = 1; i < std::min(threads, parsers.size()); ++i) {
+			pool.emplace_back(work);
+		}
+		work();
+		for (std::thread& thread : pool) {
+			thread.join();
+		}
+
+		for (parser* parser : parsers) {
+			std::vector<diagnostic>& buffer = parser->diagnostics;
+			diagnostics.insert(diagnostics.end(), std::make_move_iterator(buffer.begin()),
+				std::make_move_iterator(buffer.end()));
+			buffer.clear();
 		}
 		return result;
 	}
@@ -1,5 +1,6 @@
 #pragma once
-#include <functional>
+#include <array>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -9,31 +10,100 @@
 #include "ast.h"
 
 namespace origin {
-	typedef std::function<expr*(token op)> prefix_parselet;
-	typedef std::function<expr*(token op, expr* left)> infix_parselet;
-
 	class parser {
 	private:
-		allocator memory;
+		// what a token does at the start of an operand, or after one
+		enum class operation : unsigned char {
+			none, unary, parenthetical, binary, call, subscript, member, scope,
+		};
+
+		struct parselets {
+			operation prefix = operation::none;
+			int prefix_precedence = 0;
+			operation infix = operation::none;
+			int infix_precedence = 0;
+			bool ltr = true;
+		};
+
+		// an operator or bracket waiting on an operand, with its token, its node if it was
+		// made up front, and the precedence of the expression it's in
+		struct pending_operation {
+			operation kind;
+			int precedence;
+			token start;
+			expr* node;
+		};
+
+		static const std::array<parselets, token_kind_count> operators;
+
+		allocator own_memory;
+		allocator& arena;
+		// where nodes go as they're made: the parser's arena, except for a body read lazily
+		// once its program has been handed over, which goes where the rest of it went
+		allocator* memory;
+		allocator* adopter = nullptr;
+		size_t adopted_allocations = 0;
+		// held only by the parser, so that a skipped body can tell whether the parser that
+		// would read it is still there
+		std::shared_ptr<bool> alive = std::make_shared<bool>(true);
 		std::vector<diagnostic>& diagnostics;
-		std::unordered_map<std::string, int> op_precedence;
-		std::unordered_map<std::string, prefix_parselet> prefix_parselets;
-		std::unordered_map<std::string, infix_parselet> infix_parselets;
+		std::vector<pending_operation> pending;
+		// where each declaration this parser has read is now; a reparse moves it by updating
+		// its place alone, and its lazily read bodies, kept by their positions from its own,
+		// move with it
+		struct place {
+			size_t position;
+			size_t start;
+			source_loc loc;
+		};
+
+		struct body_range {
+			size_t place;
+			size_t position;
+			size_t end;
+		};
+
+		std::vector<place> places;
+		std::vector<body_range> body_ranges;
+		size_t current_place = 0;
 		void semi();
+		source_range to_last(source_range start);
+		bool read_operators(expr*& left, int& precedence, size_t base);
+		expr* close_call(token start, call_expr* call);
+		expr* read_member(token start, expr* left);
+		expr* read_scope(token start, expr* left);
+		void skip_typing();
+		bool is_vardecl_next();
+		bool can_defer(size_t position, size_t end);
+		void read_header(program* result);
+		void read_declaration(program* result);
+		block* read_body_at(size_t body);
+		bool reuse(program* result, declaration& old, size_t offset, size_t removed);
 	public:
 		class lexer& lexer;
+		// skips function bodies, to be read once something asks for them; a skipped body is
+		// only checked for what can be seen without parsing it (see can_defer), so other syntax
+		// errors in a body that's never read go unreported
+		bool lazy_bodies = false;
 
 		parser(origin::lexer& lexer, std::vector<diagnostic>& diagnostics);
+		parser(origin::lexer& lexer, std::vector<diagnostic>& diagnostics, allocator& memory);
+		size_t allocations() const;
+		void hand_over(allocator& to);
 		typing* read_typing();
-		expr* read_expr(const std::string& op);
-		expr* read_expr(int precedence = -1);
-		expr* read_expr(int precedence, std::function<expr*()> fail);
+		expr* read_expr(int precedence = -1, bool or_nothing = false);
 		variable* read_variable();
 		stat* read_stat();
 		block* read_block();
+		block* read_block_at(size_t position, size_t end);
+		block* read_body(lambda* lambda);
 		vardecl* read_vardecl();
+		vardecl* read_vardecl(typing* typing);
 		lambda* read_func_part(typing* return_type);
 		classdef* read_classdef();
 		program* read_program();
+		program* reparse(program* previous, size_t offset, size_t removed, std::string_view inserted);
+		static std::vector<program*> read_programs(const std::vector<parser*>& parsers,
+			std::vector<diagnostic>& diagnostics, allocator& memory, size_t threads = 0);
 	};
 }
\ No newline at end of file
@@ -1,9 +1,13 @@
+#include <algorithm>
 #include <sstream>
 #include <iostream>
+#include <memory>
 #include "lexer.h"
 #include "parser.h"
+#include "flat_ast.h"
+#include "flat_file.h"
 #include "type_analysis.h"
-#include "rang.h"
+#include "source_manager.h"
 
 using namespace std::string_literals;
 
@@ -15,7 +19,78 @@ std::string replaceAll(std::string str, std::string from, std::string to) {
 	return replaceAll(str.replace(start_pos, from.length(), to), from, to);
 }
 
-int main() {
+// checks a program on its own and writes it to path with its declarations patched, unless it
+// has diagnostics of its own
+void precompile(const std::string& path, std::string_view source) {
+	std::istringstream stream{ std::string(source) };
+	std::vector<origin::diagnostic> diagnostics;
+	origin::interner names;
+	origin::lexer lex(stream, diagnostics, names);
+	// a file of its own, so that what's written keeps its ranges
+	origin::source_manager sources;
+	sources.add(path, lex);
+	origin::parser parser(lex, diagnostics);
+	lex.tokenize();
+	origin::compilation_unit unit = { parser.read_program() };
+	origin::type_assigner assigner(diagnostics, names);
+	assigner.walk(&unit);
+	if (!diagnostics.empty()) return;
+	origin::flat_tree tree;
+	origin::flattener(names, tree).walk(unit[0]);
+	if (tree.full) return;
+	origin::write_flat_file(path, tree, source, origin::flat_patched);
+}
+
+int main(int argc, char** argv) {
+	bool on_demand_lexing = false;
+	bool lex_stats = false;
+	bool parallel_lexing = false;
+	bool read_stdin = false;
+	bool parse_stats = false;
+	bool lazy_bodies = false;
+	bool parallel_parsing = false;
+	bool flat_ast = false;
+	bool memory_stats = false;
+	std::string ast_cache;
+	std::string stdlib_snapshot;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--on-demand-lexing") {
+			on_demand_lexing = true;
+		}
+		else if (arg == "--lex-stats") {
+			lex_stats = true;
+		}
+		else if (arg == "--parallel-lexing") {
+			parallel_lexing = true;
+		}
+		else if (arg == "--stdin") {
+			read_stdin = true;
+		}
+		else if (arg == "--parse-stats") {
+			parse_stats = true;
+		}
+		else if (arg == "--lazy-bodies") {
+			lazy_bodies = true;
+		}
+		else if (arg == "--parallel-parsing") {
+			parallel_parsing = true;
+		}
+		else if (arg == "--flat-ast") {
+			flat_ast = true;
+		}
+		else if (arg == "--memory-stats") {
+			memory_stats = true;
+		}
+		else if (arg == "--ast-cache" && i + 1 < argc) {
+			ast_cache = argv[++i];
+		}
+		else if (arg == "--stdlib-snapshot" && i + 1 < argc) {
+			stdlib_snapshot = argv[++i];
+		}
+	}
+	origin::allocator::accounting = memory_stats;
+
 	std::istringstream prog(replaceAll(R":<(namespace asd::def::ghi;
 import stdlib::core;
 
@@ -239,84 +314,157 @@ public:
 	}
 }
 ):<"s, "\t"s, "    "s));
-	std::unordered_map<std::istream*, std::string> files = {
-		{&prog, "file.og"},
-		{&stdprog, "stdlib/core.og"}
-	};
 	std::vector<origin::diagnostic> diagnostics;
-	origin::lexer lex1(prog, diagnostics);
-	origin::parser pr1(lex1, diagnostics);
-	origin::lexer lex2(stdprog, diagnostics);
-	origin::parser pr2(lex2, diagnostics);
-	origin::compilation_unit unit;
-	unit.push_back(pr1.read_program());
-	unit.push_back(pr2.read_program());
-	auto assigner = origin::type_assigner(diagnostics);
-	assigner.walk(&unit);
-	//origin::type_checker(diagnostics).walk(&unit);
-	for (origin::diagnostic d : diagnostics) {
-		std::istream& prog = *d.stream;
-		if (d.stream == nullptr) continue;
-		prog.seekg(0);
-		std::string str;
-		size_t start_line = (size_t)-1;
-		size_t end_line;
-		std::string lines;
-		size_t index = 0, end_index = 0;
-		size_t ifirst;
-		size_t isecond;
-		size_t line = 0;
-		while (getline(prog, str)) {
-			line++;
-			index = end_index;
-			end_index += str.length() + 1;
-			if (d.start >= index && d.start < end_index) {
-				start_line = line;
-				ifirst = d.start - index;
-			}
-			if (start_line != (size_t)-1) lines += str + "\n";
-			if (d.end >= index && d.end < end_index) {
-				end_line = line;
-				isecond = d.end - index;
-				break;
+	// when parsed in parallel, each file keeps its diagnostics apart until all have been read
+	std::vector<origin::diagnostic> diagnostics1, diagnostics2;
+	std::vector<origin::diagnostic>& buffer1 = parallel_parsing ? diagnostics1 : diagnostics;
+	std::vector<origin::diagnostic>& buffer2 = parallel_parsing ? diagnostics2 : diagnostics;
+	origin::interner names;
+	// a program on stdin is streamed rather than read in whole
+	origin::lexer lex1 = read_stdin ? origin::lexer(std::cin, buffer1, names, 1 << 16)
+		: origin::lexer(prog, buffer1, names);
+	origin::lexer lex2(stdprog, buffer2, names);
+	origin::source_manager sources;
+	// a streamed program takes all the locations left, so it's added last
+	origin::source_loc file2 = sources.add("stdlib/core.og", lex2);
+	origin::source_loc file1 = sources.add(read_stdin ? "<stdin>" : "file.og", lex1);
+	if (file1 == 0 || file2 == 0) {
+		std::cerr << "error: too much source to be given locations" << std::endl;
+		return 1;
+	}
+	origin::parser pr1(lex1, buffer1);
+	origin::parser pr2(lex2, buffer2);
+	std::vector<origin::parser*> parsers = { &pr1, &pr2 };
+	std::vector<origin::source_loc> files = { file1, file2 };
+	origin::compilation_unit unit(parsers.size());
+	// holds the nodes of every program from here on, however it was read
+	origin::allocator compilation;
+	// programs whose source hasn't changed since they were cached are read from their flat
+	// files, and the rest are cached once parsed; with lazy bodies, a file stays mapped for the
+	// bodies that are only built once they're walked
+	std::vector<std::string> cache_paths(parsers.size());
+	std::vector<std::unique_ptr<origin::mapped_flat_file>> cached_files;
+	std::vector<origin::parser*> parsing;
+	// the stdlib is read already checked from its snapshot, which is made the first time round
+	std::unique_ptr<origin::mapped_flat_file> snapshot;
+	if (!stdlib_snapshot.empty()) {
+		snapshot.reset(new origin::mapped_flat_file(stdlib_snapshot, lex2.source(), origin::flat_patched));
+		if (!snapshot->valid()) {
+			precompile(stdlib_snapshot, lex2.source());
+			snapshot.reset(new origin::mapped_flat_file(stdlib_snapshot, lex2.source(), origin::flat_patched));
+		}
+	}
+	for (size_t i = 0; i < parsers.size(); ++i) {
+		if (files[i] == file2 && snapshot && snapshot->valid()) {
+			unit[i] = origin::inflate(snapshot->view(), compilation, names, files[i], true);
+			unit[i]->precompiled = true;
+			continue;
+		}
+		if (!ast_cache.empty() && !(read_stdin && files[i] == file1)) {
+			std::string name = sources.name(files[i]);
+			std::replace(name.begin(), name.end(), '/', '_');
+			cache_paths[i] = ast_cache + "/" + name + ".flat";
+			std::unique_ptr<origin::mapped_flat_file> cached(
+				new origin::mapped_flat_file(cache_paths[i], parsers[i]->lexer.source()));
+			if (cached->valid()) {
+				unit[i] = origin::inflate(cached->view(), compilation, names, files[i], lazy_bodies);
+				cached_files.push_back(std::move(cached));
+				cache_paths[i].clear();
+				continue;
 			}
 		}
-		std::istringstream strs(lines);
-		size_t i = start_line;
-		std::cout << rang::style::bold << (d.warning ? "warning" : "error") << "@"
-			<< files[d.stream] << " on line" << (start_line == end_line ? " " : "s ")
-			<< start_line;
-		if (start_line != end_line) {
-			std::cout << "-" << end_line;
+		parsing.push_back(parsers[i]);
+	}
+	for (origin::parser* parser : parsing) {
+		if (parallel_lexing) {
+			parser->lexer.tokenize(0);
 		}
-		if (d.template_str != "") {
-			std::cout << " while evaluating template " << d.template_str;
+		else if (!on_demand_lexing) {
+			parser->lexer.tokenize();
 		}
-		std::cout << ": " << rang::style::reset << d.message << std::endl;
-		for (std::string line; getline(strs, line); i++) {
-			std::cout << line << std::endl;
-			std::cout << (d.warning ? rang::fgB::green : rang::fgB::red);
-			if (i == start_line) {
-				size_t end = start_line == end_line ? isecond : line.length() - ifirst;
-				for (size_t i = 0; i < ifirst; ++i) {
-					std::cout << " ";
-				}
-				for (size_t i = ifirst; i <= end; ++i) {
-					std::cout << "~";
-				}
+		parser->lazy_bodies = lazy_bodies;
+	}
+	std::vector<origin::program*> programs;
+	if (parallel_parsing) {
+		programs = origin::parser::read_programs(parsing, diagnostics, compilation);
+	}
+	else {
+		for (origin::parser* parser : parsing) {
+			programs.push_back(parser->read_program());
+			parser->hand_over(compilation);
+		}
+	}
+	for (size_t i = 0, next = 0; i < unit.size(); ++i) {
+		if (unit[i] == nullptr) {
+			unit[i] = programs[next++];
+		}
+	}
+	for (size_t i = 0; i < unit.size(); ++i) {
+		if (cache_paths[i].empty()) continue;
+		origin::flat_tree tree;
+		origin::flattener(names, tree).walk(unit[i]);
+		// a program is only cached if it parsed cleanly, since its diagnostics aren't
+		bool clean = true;
+		for (auto buffer : { &diagnostics, &diagnostics1, &diagnostics2 }) {
+			for (const origin::diagnostic& d : *buffer) {
+				origin::source_loc file = sources.file_of(d.range.loc);
+				clean = clean && file != files[i] && file != 0;
 			}
-			else if (i == end_line) {
-				for (size_t i = 0; i <= isecond; ++i) {
-					std::cout << "~";
-				}
+		}
+		if (clean && !tree.full) {
+			origin::write_flat_file(cache_paths[i], tree, parsers[i]->lexer.source());
+		}
+	}
+	size_t parsed1 = pr1.allocations(), parsed2 = pr2.allocations();
+	// programs are checked from copies built back up from their flat form, unless one has
+	// more nodes of a kind than a flat tree can number, in which case it's checked as parsed
+	if (flat_ast) {
+		for (size_t i = 0; i < unit.size(); ++i) {
+			origin::flat_tree tree;
+			origin::flattener flattener(names, tree);
+			flattener.walk(unit[i]);
+			if (parse_stats) {
+				std::cerr << sources.name(files[i]) << ": " << tree.nodes() << " nodes take "
+					<< flattener.pointer_bytes << " bytes as objects, " << tree.bytes() << " flat" << std::endl;
 			}
-			else {
-				for (size_t i = 0; i < line.length(); ++i) {
-					std::cout << "~";
-				}
+			if (tree.full) {
+				diagnostics.push_back(origin::warn("too many nodes to keep flat, so checked as parsed"s,
+					{ origin::make_loc(files[i], 0), 1 }));
+				continue;
 			}
-			std::cout << rang::style::reset << std::endl;
+			bool precompiled = unit[i]->precompiled;
+			unit[i] = origin::inflate(tree.view(), compilation, names, files[i]);
+			unit[i]->precompiled = precompiled;
+		}
+	}
+	auto assigner = origin::type_assigner(diagnostics, names);
+	assigner.walk(&unit);
+	// bodies parsed lazily by the assigner report to their file's buffer
+	for (std::vector<origin::diagnostic>* buffer : { &diagnostics1, &diagnostics2 }) {
+		diagnostics.insert(diagnostics.end(), buffer->begin(), buffer->end());
+	}
+	//origin::type_checker(diagnostics).walk(&unit);
+	if (lex_stats) {
+		for (origin::source_loc file : files) {
+			origin::lexer* lex = sources.lexer(file);
+			std::cerr << sources.name(file) << ": " << lex->source().size() << " characters, "
+				<< lex->relexed() << " re-lexed" << std::endl;
 		}
 	}
+	if (parse_stats) {
+		std::cerr << sources.name(file1) << ": " << parsed1 << " nodes allocated while parsing, "
+			<< pr1.allocations() << " in all" << std::endl;
+		std::cerr << sources.name(file2) << ": " << parsed2 << " nodes allocated while parsing, "
+			<< pr2.allocations() << " in all" << std::endl;
+	}
+	if (memory_stats) {
+		origin::memory_phase_scope phase(origin::memory_phase::lex);
+		static const size_t kind = origin::allocator::kind("lexer buffers");
+		origin::allocator::account(kind, lex1.footprint() + lex2.footprint(), 2);
+		origin::allocator::report(std::cerr);
+	}
+	for (const origin::diagnostic& d : diagnostics) {
+		sources.render(d, std::cout);
+	}
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace origin {
+	// a place in a compilation's source, in one space of locations shared by all its files: a
+	// source_manager gives each file a stretch of it as it's added, and a location is the start
+	// of its file's stretch plus its offset there, until a parser reads the file again after an
+	// edit and hands out more of the stretch (see parser::reparse); the manager never gives out
+	// 0, and source it doesn't know about, such as a lexer's given as a string, starts at 0, so
+	// the locations of a program read whole from it are just its offsets
+	typedef uint32_t source_loc;
+	constexpr source_loc no_loc = 0;
+	constexpr size_t loc_space = (size_t)UINT32_MAX + 1;
+
+	inline source_loc make_loc(source_loc base, size_t offset) {
+		return base + (source_loc)offset;
+	}
+
+	// length characters from loc on; one that's never been set is empty
+	struct source_range {
+		source_loc loc = no_loc;
+		uint32_t length = 0;
+	};
+
+	// whether a range was ever given a place; only the default one wasn't
+	inline bool is_set(source_range range) {
+		return range.loc != no_loc || range.length != 0;
+	}
+
+	// the location of a range's last character; error recovery can end a range before it
+	// starts, and then its length wraps around, so this still gives back where it ended
+	inline source_loc last_loc(source_range range) {
+		return range.loc + range.length - 1;
+	}
+
+	inline source_range make_range(source_loc base, size_t start, size_t last) {
+		return { make_loc(base, start), (uint32_t)(last - start) + 1 };
+	}
+
+	// from the start of first to the end of last
+	inline source_range span(source_range first, source_range last) {
+		return { first.loc, last_loc(last) - first.loc + 1 };
+	}
+
+	inline source_loc moved(source_loc loc, ptrdiff_t delta) {
+		return loc + (source_loc)delta;
+	}
+
+	inline source_range moved(source_range range, ptrdiff_t delta) {
+		return { moved(range.loc, delta), range.length };
+	}
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "source_manager.h"
+#include <algorithm>
+#include "rang.h"
+
+namespace origin {
+	// a file's locations run from its base up to the offset of its <eof>; an editable one is given
+	// as many again three times over, as far as there are any left, for a parser reading it
+	// again after edits to hand out (see parser::reparse)
+	source_loc source_manager::add(const std::string& name, origin::lexer& lexer, bool editable) {
+		size_t left = loc_space - next;
+		size_t needed = lexer.streaming() ? left : lexer.source().size() + 1;
+		if (left == 0 || needed > left) return 0;
+		size_t room = editable ? std::min(left, needed * 4) : needed;
+		source_loc base = (source_loc)next;
+		sources.push_back({ name, &lexer, base, room });
+		next += room;
+		lexer.place(base, room);
+		return base;
+	}
+
+	const source_manager::source* source_manager::find(source_loc loc) const {
+		auto after = std::upper_bound(sources.begin(), sources.end(), loc,
+			[](source_loc loc, const source& source) { return loc < source.base; });
+		if (after == sources.begin()) return nullptr;
+		const source* found = &*(after - 1);
+		return loc - found->base < found->room ? found : nullptr;
+	}
+
+	source_loc source_manager::file_of(source_loc loc) const {
+		const source* found = find(loc);
+		return found == nullptr ? 0 : found->base;
+	}
+
+	const std::string& source_manager::name(source_loc file) const {
+		static const std::string none;
+		const source* found = find(file);
+		return found == nullptr ? none : found->name;
+	}
+
+	origin::lexer* source_manager::lexer(source_loc file) const {
+		const source* found = find(file);
+		return found == nullptr ? nullptr : found->lexer;
+	}
+
+	void source_manager::render(const diagnostic& d, std::ostream& out) const {
+		const source* file = find(d.range.loc);
+		if (file == nullptr) return;
+		origin::lexer* lex = file->lexer;
+		size_t start = lex->offset_at(d.range.loc);
+		size_t last = lex->offset_at(last_loc(d.range));
+		size_t start_line = lex->line_of(start);
+		size_t end_line = lex->line_of(last);
+		size_t ifirst = lex->column_of(start);
+		size_t isecond = lex->column_of(last);
+		out << rang::style::bold << (d.warning ? "warning" : "error") << "@"
+			<< file->name << " on line" << (start_line == end_line ? " " : "s ")
+			<< start_line;
+		if (start_line != end_line) {
+			out << "-" << end_line;
+		}
+		if (d.template_str != "") {
+			out << " while evaluating template " << d.template_str;
+		}
+		out << ": " << rang::style::reset << d.message << std::endl;
+		for (size_t i = start_line; i <= end_line; i++) {
+			std::string_view line = lex->line(i);
+			out << line << std::endl;
+			out << (d.warning ? rang::fgB::green : rang::fgB::red);
+			if (i == start_line) {
+				size_t end = start_line == end_line ? isecond : line.length() - ifirst;
+				for (size_t i = 0; i < ifirst; ++i) {
+					out << " ";
+				}
+				for (size_t i = ifirst; i <= end; ++i) {
+					out << "~";
+				}
+			}
+			else if (i == end_line) {
+				for (size_t i = 0; i <= isecond; ++i) {
+					out << "~";
+				}
+			}
+			else {
+				for (size_t i = 0; i < line.length(); ++i) {
+					out << "~";
+				}
+			}
+			out << rang::style::reset << std::endl;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "source_loc.h"
+
+namespace origin {
+	// the files of a compilation, each given a stretch of its locations and known by where that
+	// starts, and what's needed to turn a location back into a file name, line and column
+	class source_manager {
+	private:
+		struct source {
+			std::string name;
+			origin::lexer* lexer;
+			source_loc base;
+			size_t room;
+		};
+
+		// in the order they were added, which is also the order of their bases
+		std::vector<source> sources;
+		// location 0 is never given out
+		size_t next = 1;
+
+		const source* find(source_loc loc) const;
+	public:
+		// places the lexer's source after the last one added and returns where it starts; a
+		// streamed source, whose size isn't known, takes all the locations left, and is cut
+		// short with an error if it runs past them; 0 when there isn't room, which is an error;
+		// a source that will be edited should be added as editable, since otherwise it has no
+		// locations to spare: it can't grow, and every reparse reads it whole;
+		// lexer::offset_at turns the file's locations back into offsets
+		source_loc add(const std::string& name, origin::lexer& lexer, bool editable = false);
+		// the start of the file a location is in, or 0 for one that isn't in any
+		source_loc file_of(source_loc loc) const;
+		const std::string& name(source_loc file) const;
+		origin::lexer* lexer(source_loc file) const;
+		// writes out where a diagnostic is and the lines it covers, marked; ones that aren't in
+		// any known file are left out
+		void render(const diagnostic& diagnostic, std::ostream& out) const;
+	};
+}
\ No newline at end of file
@@ -22,11 +22,11 @@ namespace origin {
 	scope::scope(scope* parent) : parent(parent) {
 	}
 
-	bool scope::has(const std::string& name) {
+	bool scope::has(atom name) {
 		return variables.find(name) != variables.end();
 	}
 
-	typing* scope::get(const std::string& name) {
+	typing* scope::get(atom name) {
 		if (variables.find(name) == variables.end()) {
 			if (parent) {
 				return parent->get(name);
@@ -40,22 +40,28 @@ namespace origin {
 		}
 	}
 
-	void scope::declare(const std::string& name, typing* typing) {
+	void scope::declare(atom name, typing* typing) {
 		if (typing == nullptr) return;
 		variables[name] = typing;
 	}
 
+	// from where a typing's template types start to its end
+	static source_range generic_range(typing* typing) {
+		return span({ typing->generic_loc, 1 }, typing->range);
+	}
+
 	class templater : public walker<void> {
 	private:
 		allocator& memory;
 		std::vector<diagnostic>& diagnostics;
+		interner& names;
 		std::unordered_map<std::string, typing*>& map;
 		std::string variadic;
 		std::vector<typing*>& variadic_types;
 	public:
-		templater(allocator& memory, std::vector<diagnostic>& diagnostics,
+		templater(allocator& memory, std::vector<diagnostic>& diagnostics, interner& names,
 			std::unordered_map<std::string, typing*>& map, const std::string& variadic, std::vector<typing*>& types)
-			: memory(memory), diagnostics(diagnostics), map(map), variadic(variadic), variadic_types(types) {
+			: memory(memory), diagnostics(diagnostics), names(names), map(map), variadic(variadic), variadic_types(types) {
 		}
 
 		void walk(typing* typing) {
@@ -63,10 +69,10 @@ namespace origin {
 			if (map.find(typing->name) != map.end()) {
 				if (typing->templates.size() > 0) {
 					diagnostics.push_back(error("template type cannot have templates of its own"s,
-						typing->generic_token, typing->end));
+						generic_range(typing)));
 				}
 				else {
-					typing->generic_token = typing->start;
+					typing->generic_loc = typing->range.loc;
 				}
 				auto change = map[typing->name];
 				typing->alias_name = typing->name = change->name;
@@ -77,15 +83,15 @@ namespace origin {
 				std::vector<origin::typing*> templates;
 				for (auto t : typing->templates) {
 					if (!can_have_more) {
-						diagnostics.push_back(error("cannot have more templates after variadic template"s, t->start, t->end));
+						diagnostics.push_back(error("cannot have more templates after variadic template"s, t->range));
 					}
 					else if (t->name == variadic) {
 						if (t->templates.size() > 0) {
 							diagnostics.push_back(error("template type cannot have templates of its own"s,
-								t->generic_token, t->end));
+								generic_range(t)));
 						}
 						else {
-							t->generic_token = t->start;
+							t->generic_loc = t->range.loc;
 						}
 						can_have_more = false;
 						for (auto s : variadic_types) {
@@ -134,29 +140,29 @@ namespace origin {
 			walk(expr->return_type);
 			bool can_have_more = true;
 			std::vector<typing*> types;
-			std::vector<std::string> names;
+			std::vector<atom> param_names;
 			size_t i = 0, k = 0;
 			for (auto s : expr->param_types) {
 				if (!can_have_more) {
-					diagnostics.push_back(error("cannot have more parameters after variadic template"s, s->start, s->end));
+					diagnostics.push_back(error("cannot have more parameters after variadic template"s, s->range));
 				}
 				else if (s->name == variadic) {
 					can_have_more = false;
 					for (auto t : variadic_types) {
 						types.push_back(t);
 						std::ostringstream str;
-						str << expr->param_names[i] << "..." << k++;
-						names.push_back(str.str());
+						str << names.get(expr->param_names[i]) << "..." << k++;
+						param_names.push_back(names.intern(str.str()));
 					}
 				} else {
 					walk(s);
 					types.push_back(s);
-					names.push_back(expr->param_names[i++]);
+					param_names.push_back(expr->param_names[i++]);
 				}
 			}
-			expr->param_names = names;
+			expr->param_names = param_names;
 			expr->param_types = types;
-			walk(expr->block);
+			walk(expr->body());
 			auto typing = memory.allocate<origin::typing>();
 			typing->alias_name = typing->name = "stdlib::core::function";
 			typing->templates.push_back(expr->return_type);
@@ -215,9 +221,8 @@ namespace origin {
 		typing* walk(typing* typing) {
 			if (typing == nullptr) return nullptr;
 			auto result = memory.allocate<origin::typing>();
-			result->start = typing->start;
-			result->end = typing->end;
-			result->generic_token = typing->generic_token;
+			result->range = typing->range;
+			result->generic_loc = typing->generic_loc;
 			result->alias_name = result->name = typing->name;
 			std::vector<origin::typing*> clone;
 			for (auto t : typing->templates) {
@@ -286,29 +291,26 @@ namespace origin {
 
 		vardecl* walk(vardecl* stat) {
 			auto result = memory.allocate<vardecl>();
-			result->start = stat->start;
-			result->end = stat->end;
+			result->range = stat->range;
 			if (stat->init_value != nullptr) {
 				result->init_value = walk_expr(stat->init_value);
 			}
 			result->typing = walk(stat->typing);
 			result->variable = stat->variable;
-			result->var_token = stat->var_token;
+			result->var_range = stat->var_range;
 			return result;
 		}
 
 		expr_stat* walk(expr_stat* stat) {
 			auto result = memory.allocate<expr_stat>();
-			result->start = stat->start;
-			result->end = stat->end;
+			result->range = stat->range;
 			result->expr = walk_expr(stat->expr);
 			return result;
 		}
 
 		if_stat* walk(if_stat* stat) {
 			auto result = memory.allocate<if_stat>();
-			result->start = stat->start;
-			result->end = stat->end;
+			result->range = stat->range;
 			result->cond = walk_expr(stat->cond);
 			result->body = walk_stat(stat->body);
 			result->else_body = walk_stat(stat->else_body);
@@ -317,8 +319,7 @@ namespace origin {
 
 		block* walk(block* stat) {
 			auto result = memory.allocate<block>();
-			result->start = stat->start;
-			result->end = stat->end;
+			result->range = stat->range;
 			std::vector<origin::stat*> clone;
 			for (auto t : stat->stats) {
 				clone.push_back(walk_stat(t));
@@ -329,25 +330,24 @@ namespace origin {
 
 		return_stat* walk(return_stat* stat) {
 			auto result = memory.allocate<return_stat>();
-			result->start = stat->start;
-			result->end = stat->end;
+			result->range = stat->range;
 			result->expr = walk_expr(stat->expr);
 			return result;
 		}
 
 		error_expr* walk(error_expr* expr) {
 			auto result = memory.allocate<error_expr>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->typing = walk(expr->typing);
 			return result;
 		}
 
 		lambda* walk(lambda* expr) {
 			auto result = memory.allocate<lambda>();
-			result->start = expr->start;
-			result->end = expr->end;
-			result->block = walk(expr->block);
+			result->range = expr->range;
+			// a body that hasn't been parsed yet is parsed afresh for the clone instead
+			result->block = expr->block != nullptr ? walk(expr->block) : nullptr;
+			result->read_block = expr->read_block;
 			result->return_type = walk(expr->return_type);
 			result->param_names = expr->param_names;
 			std::vector<typing*> clone;
@@ -361,8 +361,7 @@ namespace origin {
 
 		parenthetical* walk(parenthetical* expr) {
 			auto result = memory.allocate<parenthetical>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->expr = walk_expr(expr->expr);
 			result->typing = walk(expr->typing);
 			return result;
@@ -370,8 +369,7 @@ namespace origin {
 
 		int_literal* walk(int_literal* expr) {
 			auto result = memory.allocate<int_literal>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->value = expr->value;
 			result->typing = walk(expr->typing);
 			return result;
@@ -379,8 +377,7 @@ namespace origin {
 
 		variable* walk(variable* expr) {
 			auto result = memory.allocate<variable>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->name = expr->name;
 			result->typing = walk(expr->typing);
 			return result;
@@ -388,19 +385,17 @@ namespace origin {
 
 		member* walk(member* expr) {
 			auto result = memory.allocate<member>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->object = walk_expr(expr->object);
 			result->name = expr->name;
-			result->name_token = expr->name_token;
+			result->name_range = expr->name_range;
 			result->typing = walk(expr->typing);
 			return result;
 		}
 
 		subscript* walk(subscript* expr) {
 			auto result = memory.allocate<subscript>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->left = walk_expr(expr->left);
 			result->right = walk_expr(expr->right);
 			result->typing = walk(expr->typing);
@@ -409,8 +404,7 @@ namespace origin {
 
 		call_expr* walk(call_expr* expr) {
 			auto result = memory.allocate<call_expr>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->typing = walk(expr->typing);
 			result->function = walk_expr(expr->function);
 			std::vector<origin::expr*> clone;
@@ -423,21 +417,21 @@ namespace origin {
 
 		bin_expr* walk(bin_expr* expr) {
 			auto result = memory.allocate<bin_expr>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->left = walk_expr(expr->left);
 			result->right = walk_expr(expr->right);
 			result->op = expr->op;
-			result->op_token = expr->op_token;
+			result->op_kind = expr->op_kind;
+			result->op_range = expr->op_range;
 			result->typing = walk(expr->typing);
 			return result;
 		}
 
 		un_expr* walk(un_expr* expr) {
 			auto result = memory.allocate<un_expr>();
-			result->start = expr->start;
-			result->end = expr->end;
+			result->range = expr->range;
 			result->op = expr->op;
+			result->op_kind = expr->op_kind;
 			result->expr = walk_expr(expr->expr);
 			result->typing = walk(expr->typing);
 			return result;
@@ -447,14 +441,31 @@ namespace origin {
 		}
 	};
 
-	type_assigner::type_assigner(std::vector<diagnostic>& diagnostics)
-		: current_scope(new scope()), diagnostics(diagnostics) {
+	type_assigner::type_assigner(std::vector<diagnostic>& diagnostics, interner& names)
+		: memory(own_memory), current_scope(new scope()), diagnostics(diagnostics), names(names) {
+	}
+
+	type_assigner::type_assigner(std::vector<diagnostic>& diagnostics, interner& names, allocator& memory)
+		: memory(memory), current_scope(new scope()), diagnostics(diagnostics), names(names) {
 	}
 
 	type_assigner::~type_assigner() {
 		while (current_scope != nullptr) upscope();
 	}
 
+	atom type_assigner::known(atom& name, const char* text) {
+		if (name == 0) name = names.intern(text);
+		return name;
+	}
+
+	// the member function an operator calls; one whose kind isn't known is looked up by name
+	atom type_assigner::operator_name(token_kind kind, const std::string& op) {
+		if (kind == token_kind::none) return names.intern("operator"s + op);
+		atom& name = operator_names[(size_t)kind];
+		if (name == 0) name = names.intern("operator"s + op);
+		return name;
+	}
+
 	void type_assigner::downscope() {
 		current_scope = new scope(current_scope);
 	}
@@ -462,6 +473,13 @@ namespace origin {
 	void type_assigner::upscope() {
 		auto old = current_scope;
 		current_scope = old->parent;
+		if (allocator::accounting) {
+			// roughly: a node per variable, holding it and the next pointer, and the buckets
+			static const size_t kind = allocator::kind("scope");
+			auto& variables = old->variables;
+			allocator::account(kind, sizeof(scope) + variables.bucket_count() * sizeof(void*)
+				+ variables.size() * (sizeof(*variables.begin()) + sizeof(void*)));
+		}
 		delete old;
 	}
 	
@@ -492,6 +510,7 @@ namespace origin {
 		if (typing == nullptr) return nullptr;
 		if (classes.find(typing->name) == classes.end()) return nullptr;
 		auto result = classes[typing->name];
+		result->members();
 		if (result->generics.size() > 0) {
 			if (generic_classes.find(typing) != generic_classes.end()) {
 				return generic_classes[typing];
@@ -501,6 +520,7 @@ namespace origin {
 				(result->variadic && typing->templates.size() >= result->generics.size() - 1))) {
 				return nullptr;
 			}
+			memory_phase_scope phase(memory_phase::templates);
 			auto old_program = current_program;
 			auto old_scope = current_scope;
 			current_scope = new scope();
@@ -512,7 +532,7 @@ namespace origin {
 			clone->accesses = result->accesses;
 			clone->generics = result->generics;
 			clone->name = result->name;
-			clone->name_token = result->name_token;
+			clone->name_range = result->name_range;
 			clone->program = result->program;
 			clone->variadic = result->variadic;
 			for (auto stat : result->vardecls) {
@@ -530,10 +550,10 @@ namespace origin {
 					types.push_back(typing->templates[i]);
 				}
 			}
-			templater t(memory, diagnostics, map, result->variadic ? result->generics.back() : ""s, types);
+			templater t(memory, diagnostics, names, map, result->variadic ? result->generics.back() : ""s, types);
 			downscope();
 			generic_classes[typing] = clone;
-			current_scope->declare("self", typing);
+			current_scope->declare(known(self_name, "self"), typing);
 			for (auto stat : clone->vardecls) {
 				if (stat->init_value) t.walk_expr(stat->init_value);
 				if (stat->typing != nullptr) {
@@ -569,56 +589,54 @@ namespace origin {
 		for (auto t : typing->templates) {
 			patch(t);
 		}
-		std::vector<std::string> names;
+		std::vector<std::string> candidates;
 		if (typing->name.find("::"s) != std::string::npos) {
-			names.push_back(typing->name);
+			candidates.push_back(typing->name);
 		}
 		else {
-			names.push_back(current_program->namespace_name + "::" + typing->name);
+			candidates.push_back(current_program->namespace_name + "::" + typing->name);
 			for (auto s : current_program->imports) {
-				names.push_back(s->name + "::" + typing->name);
+				candidates.push_back(names.get(s->name) + "::" + typing->name);
 			}
 		}
-		for (auto name : names) {
+		for (auto name : candidates) {
 			if (typedefs.find(name) != typedefs.end()) {
 				auto res = patch(typedefs[name]);
-				typing->start = res->start;
-				typing->end = res->end;
+				typing->range = res->range;
 				typing->alias = true;
-				typing->generic_token = res->generic_token;
+				typing->generic_loc = res->generic_loc;
 				typing->name = res->name;
 				typing->templates = res->templates;
 				return typing;
 			}
 		}
-		for (auto name : names) {
+		for (auto name : candidates) {
 			if (classes.find(name) != classes.end()) {
 				auto classdef = classes[name];
 				if (classdef->generics.size() > 0) {
 					if (!(typing->templates.size() == classdef->generics.size()
 						|| (classdef->variadic && typing->templates.size() >= classdef->generics.size() - 1))) {
-						diagnostics.push_back(error("incorrect number of template types"s, typing->generic_token, typing->end));
+						diagnostics.push_back(error("incorrect number of template types"s, generic_range(typing)));
 					}
 				}
 				else {
 					if (typing->templates.size() > 0) {
 						diagnostics.push_back(error("template types don't belong on a non-generic type"s,
-							typing->generic_token, typing->end));
+							generic_range(typing)));
 					}
 				}
 				typing->name = name;
 				return typing;
 			}
 		}
-		diagnostics.push_back(error("unknown type "s + typing->name, typing->start,
-			typing->end));
+		diagnostics.push_back(error("unknown type "s + typing->name, typing->range));
 		return typing;
 	}
 
 	void type_assigner::walk(vardecl* stat) {
 		if (stat->init_value) walk_expr(stat->init_value);
 		if (current_scope->has(stat->variable)) {
-			diagnostics.push_back(warn("duplicate variable declaration"s, stat->var_token));
+			diagnostics.push_back(warn("duplicate variable declaration"s, stat->var_range));
 		}
 		current_scope->declare(stat->variable, patch(stat->typing));
 	}
@@ -657,7 +675,7 @@ namespace origin {
 			patch(expr->param_types[i]);
 			current_scope->declare(expr->param_names[i], expr->param_types[i]);
 		}
-		walk(expr->block);
+		walk(expr->body());
 		upscope();
 		auto typing = memory.allocate<origin::typing>();
 		typing->alias_name = typing->name = "stdlib::core::function";
@@ -683,7 +701,7 @@ namespace origin {
 		if (typing* typing = current_scope->get(expr->name)) {
 			expr->typing = typing;
 		} else {
-			diagnostics.push_back(error("undefined variable"s, expr->start, expr->end));
+			diagnostics.push_back(error("undefined variable"s, expr->range));
 			typing = memory.allocate<origin::typing>();
 			typing->alias_name = typing->name = "<error type>";
 			expr->typing = typing;
@@ -703,13 +721,13 @@ namespace origin {
 				}
 			}
 		}
-		diagnostics.push_back(error("undefined member '"s + expr->name + "'",
-			expr->name_token));
+		diagnostics.push_back(error("undefined member '"s + names.get(expr->name) + "'",
+			expr->name_range));
 	}
 
 	static void* bad_ptr = (void*)(uintptr_t)(-1);
 
-	vardecl* type_assigner::find_overload(const std::string& name, typing* typing,
+	vardecl* type_assigner::find_overload(atom name, typing* typing,
 		const std::vector<origin::typing*>& expected_params) {
 		bool found_overload = false;
 		if (classdef* classdef = find_class(typing)) {
@@ -738,14 +756,14 @@ namespace origin {
 	void type_assigner::walk(subscript* expr) {
 		walk_expr(expr->left);
 		walk_expr(expr->right);
-		vardecl* overload = find_overload("operator["s, expr->left->typing, std::vector<origin::typing*>({ expr->right->typing }));
+		vardecl* overload = find_overload(known(subscript_name, "operator["), expr->left->typing, std::vector<origin::typing*>({ expr->right->typing }));
 		if (overload == bad_ptr) {
 			diagnostics.push_back(error("no overload of member operator[] matches the given parameters"s,
-				expr->left->start, expr->left->end));
+				expr->left->range));
 		}
 		else if (overload == nullptr) {
 			diagnostics.push_back(error("undefined member operator[]"s,
-				expr->left->start, expr->left->end));
+				expr->left->range));
 		}
 		else {
 			expr->typing = overload->typing->templates[0];
@@ -761,14 +779,14 @@ namespace origin {
 		for (auto arg : expr->args) {
 			types.push_back(arg->typing);
 		}
-		vardecl* overload = find_overload("operator("s, expr->function->typing, types);
+		vardecl* overload = find_overload(known(call_name, "operator("), expr->function->typing, types);
 		if (overload == bad_ptr) {
 			diagnostics.push_back(error("no overload of member operator() matches the given parameters"s,
-				expr->function->start, expr->function->end));
+				expr->function->range));
 		}
 		else if (overload == nullptr) {
 			diagnostics.push_back(error("undefined member operator()"s,
-				expr->function->start, expr->function->end));
+				expr->function->range));
 		}
 		else {
 			expr->typing = overload->typing->templates[0];
@@ -776,7 +794,7 @@ namespace origin {
 	}
 
 	void type_assigner::walk(bin_expr* expr) {
-		if (expr->op == "=") {
+		if (expr->op_kind == token_kind::assign) {
 			variable* var;
 			member* mem;
 			if ((var = dynamic_cast<variable*>(expr->left)) || (mem = dynamic_cast<member*>(expr->left))) {
@@ -784,7 +802,7 @@ namespace origin {
 				walk_expr(expr->right);
 				if (!type_equals(expr->left->typing, expr->right->typing)) {
 					diagnostics.push_back(error("type mismatch"s,
-						expr->left->start, expr->left->end));
+						expr->left->range));
 				}
 				expr->typing = expr->left->typing;
 			}
@@ -792,15 +810,15 @@ namespace origin {
 				walk_expr(subs->left);
 				walk_expr(subs->right);
 				walk_expr(expr->right);
-				vardecl* overload = find_overload("operator[="s, subs->left->typing, std::vector<origin::typing*>({
+				vardecl* overload = find_overload(known(subscript_assign_name, "operator[="), subs->left->typing, std::vector<origin::typing*>({
 					subs->right->typing, expr->right->typing }));
 				if (overload == bad_ptr) {
 					diagnostics.push_back(error("no overload of member operator[]= matches the given parameters"s,
-						expr->left->start, expr->left->end));
+						expr->left->range));
 				}
 				else if (overload == nullptr) {
 					diagnostics.push_back(error("undefined member operator[]="s,
-						expr->left->start, expr->left->end));
+						expr->left->range));
 				}
 				else {
 					expr->typing = overload->typing->templates[0];
@@ -809,21 +827,21 @@ namespace origin {
 			else {
 				walk_expr(expr->right);
 				diagnostics.push_back(error("expected lvalue"s,
-					expr->left->start, expr->left->end));
+					expr->left->range));
 			}
 			return;
 		}
 		walk_expr(expr->left);
 		walk_expr(expr->right);
-		vardecl* overload = find_overload("operator"s + expr->op, expr->left->typing, std::vector<origin::typing*>({
+		vardecl* overload = find_overload(operator_name(expr->op_kind, expr->op), expr->left->typing, std::vector<origin::typing*>({
 			expr->right->typing }));
 		if (overload == bad_ptr) {
 			diagnostics.push_back(error("no overload of member operator"s + expr->op + " matches the given parameters"s,
-				expr->left->start, expr->left->end));
+				expr->left->range));
 		}
 		else if (overload == nullptr) {
 			diagnostics.push_back(error("undefined member operator"s + expr->op,
-				expr->left->start, expr->left->end));
+				expr->left->range));
 		}
 		else {
 			expr->typing = overload->typing->templates[0];
@@ -832,14 +850,14 @@ namespace origin {
 
 	void type_assigner::walk(un_expr* expr) {
 		walk_expr(expr->expr);
-		vardecl* overload = find_overload("operator"s + expr->op, expr->expr->typing, {});
+		vardecl* overload = find_overload(operator_name(expr->op_kind, expr->op), expr->expr->typing, {});
 		if (overload == bad_ptr) {
 			diagnostics.push_back(error("no overload of member operator"s + expr->op + " matches the given parameters"s,
-				expr->expr->start, expr->expr->end));
+				expr->expr->range));
 		}
 		else if (overload == nullptr) {
 			diagnostics.push_back(error("undefined member operator"s + expr->op,
-				expr->expr->start, expr->expr->end));
+				expr->expr->range));
 		}
 		else {
 			expr->typing = overload->typing->templates[0];
@@ -848,6 +866,7 @@ namespace origin {
 
 	void type_assigner::walk(compilation_unit* unit) {
 		this->unit = unit;
+		memory_phase_scope phase(memory_phase::typedefs);
 		std::unordered_set<std::string> namespaces;
 		for (auto program : *unit) {
 			namespaces.emplace(program->namespace_name);
@@ -857,8 +876,8 @@ namespace origin {
 		}
 		for (auto program : *unit) {
 			for (auto s : program->imports) {
-				if (namespaces.find(s->name) == namespaces.end()) {
-					diagnostics.push_back(error("unknown namespace"s, s->start, s->end));
+				if (namespaces.find(names.get(s->name)) == namespaces.end()) {
+					diagnostics.push_back(error("unknown namespace"s, s->range));
 				}
 			}
 		}
@@ -867,21 +886,23 @@ namespace origin {
 			for (auto classdef : program->classes) {
 				classdef->program = program;
 				std::string& ns = current_program->namespace_name;
-				std::string name = ns + "::" + classdef->name;
+				std::string name = ns + "::" + names.get(classdef->name);
 				if (classes.find(name) == classes.end()) {
 					classes[name] = classdef;
 				}
 				else {
-					auto other = classes[name]->name_token;
+					auto other = classes[name]->name_range;
 					diagnostics.push_back(error("conflicting class definitions"s, other));
 					diagnostics.push_back(error("conflicting class definitions"s,
-						classdef->name_token));
+						classdef->name_range));
 				}
 			}
 		}
 		for (auto program : *unit) {
+			if (program->precompiled) continue;
 			current_program = program;
 			for (auto classdef : program->classes) {
+				classdef->members();
 				if (classdef->generics.size() == 0) {
 					for (auto stat : classdef->vardecls) {
 						if (stat->typing != nullptr) {
@@ -891,7 +912,9 @@ namespace origin {
 				}
 			}
 		}
+		memory_phase_scope bodies(memory_phase::bodies);
 		for (auto program : *unit) {
+			if (program->precompiled) continue;
 			current_program = program;
 			downscope();
 			for (auto s : program->vardecls) {
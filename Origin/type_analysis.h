@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <unordered_map>
 #include "ast.h"
 #include "walker.h"
@@ -10,29 +11,41 @@ namespace origin {
 	class scope {
 	public:
 		scope* parent;
-		std::unordered_map<std::string, typing*> variables;
+		std::unordered_map<atom, typing*> variables;
 
 		scope();
 		scope(scope* parent);
 
-		bool has(const std::string& name);
-		typing* get(const std::string& name);
-		void declare(const std::string& name, typing* typing);
+		bool has(atom name);
+		typing* get(atom name);
+		void declare(atom name, typing* typing);
 	};
 
 	class type_assigner : public walker<void> {
 	private:
-		allocator memory;
+		allocator own_memory;
+		allocator& memory;
 		compilation_unit* unit;
 		scope* current_scope;
 		std::vector<diagnostic>& diagnostics;
+		interner& names;
 		program* current_program;
 		std::unordered_map<std::string, classdef*> classes;
 		std::unordered_map<typing*, classdef*> generic_classes;
 		std::unordered_map<std::string, typing*> typedefs;
 		std::vector<typing*> current_template;
+		// names looked up for every node they apply to, interned the first time they're needed
+		atom self_name = 0;
+		atom subscript_name = 0;
+		atom call_name = 0;
+		atom subscript_assign_name = 0;
+		std::array<atom, token_kind_count> operator_names = {};
+
+		atom known(atom& name, const char* text);
+		atom operator_name(token_kind kind, const std::string& op);
 	public:
-		type_assigner(std::vector<diagnostic>& diagnostics);
+		type_assigner(std::vector<diagnostic>& diagnostics, interner& names);
+		type_assigner(std::vector<diagnostic>& diagnostics, interner& names, allocator& memory);
 		~type_assigner();
 
 		void downscope();
@@ -54,7 +67,7 @@ namespace origin {
 		virtual void walk(variable* expr);
 		virtual void walk(member* expr);
 
-		vardecl* find_overload(const std::string& name, typing* typing, const std::vector<origin::typing*>& expected_params);
+		vardecl* find_overload(atom name, typing* typing, const std::vector<origin::typing*>& expected_params);
 
 		virtual void walk(subscript* expr);
 		virtual void walk(call_expr* expr);
@@ -0,0 +1,346 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+
+// times the lexer and the parser on generated corpora of a few different shapes; every corpus
+// comes out the same on every run and platform, so numbers can be compared between builds
+
+using namespace std::string_literals;
+
+// xorshift, since the standard distributions aren't the same everywhere
+class generator {
+private:
+	uint64_t state;
+public:
+	generator(uint64_t seed) : state(seed) {}
+
+	size_t below(size_t n) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return (size_t)(state % n);
+	}
+
+	const char* pick(const std::vector<const char*>& options) {
+		return options[below(options.size())];
+	}
+};
+
+static const std::vector<const char*> identifiers = { "a", "b", "count", "value", "index", "x", "y", "total" };
+static const std::vector<const char*> types = { "int", "uint", "byte", "char", "half", "bool" };
+static const std::vector<const char*> operators = { " + ", " - ", " * ", " / ", " % ", " == ", " < ",
+	" && ", " | ", " <<~ " };
+
+static std::string name(generator& random) {
+	return random.pick(identifiers) + std::to_string(random.below(100));
+}
+
+static std::string operand(generator& random) {
+	switch (random.below(5)) {
+	case 0:
+		return std::to_string(random.below(1000));
+	case 1:
+		return name(random) + "." + random.pick(identifiers);
+	case 2:
+		return name(random) + "[" + name(random) + "]";
+	case 3:
+		return "f" + std::to_string(random.below(50)) + "(" + name(random) + ", " + std::to_string(random.below(10)) + ")";
+	default:
+		return name(random);
+	}
+}
+
+static std::string expression(generator& random, size_t terms) {
+	std::string result = operand(random);
+	for (size_t i = 1; i < terms; ++i) {
+		result += random.pick(operators) + operand(random);
+	}
+	return result;
+}
+
+// an expression depth levels deep, nesting through parentheses, unary operators, calls and
+// subscripts
+static std::string nested(generator& random, size_t depth) {
+	std::string open, close;
+	for (size_t i = 0; i < depth; ++i) {
+		switch (random.below(4)) {
+		case 0:
+			open += "(" + operand(random) + random.pick(operators);
+			close = ")" + close;
+			break;
+		case 1:
+			open += "-(";
+			close = ")" + close;
+			break;
+		case 2:
+			open += "g(" + operand(random) + ", ";
+			close = ")" + close;
+			break;
+		default:
+			open += name(random) + "[";
+			close = "]" + close;
+			break;
+		}
+	}
+	return open + operand(random) + close;
+}
+
+// a typing with templates depth levels deep
+static std::string templated(generator& random, size_t depth) {
+	std::string result = random.below(2) ? random.pick(types) : "list"s;
+	if (depth > 0) {
+		result = (random.below(2) ? "map<"s : "pair<"s) + templated(random, depth - 1) + ", "
+			+ templated(random, random.below(depth)) + ">";
+	}
+	if (random.below(4) == 0) result += "[]";
+	return result;
+}
+
+static std::string function(generator& random, size_t index, size_t statements) {
+	std::string result = random.pick(types) + " f"s + std::to_string(index) + "(int a, int b) {\n";
+	for (size_t i = 0; i < statements; ++i) {
+		if (random.below(3) == 0) {
+			result += "\t"s + random.pick(types) + " " + name(random) + " = " + expression(random, 1 + random.below(4)) + ";\n";
+		}
+		else {
+			result += "\t" + name(random) + " = " + expression(random, 1 + random.below(4)) + ";\n";
+		}
+	}
+	return result + "\treturn " + expression(random, 2) + ";\n}\n\n";
+}
+
+static std::string classdef(generator& random, size_t index) {
+	std::string result = "class c"s + std::to_string(index) + " {\npublic:\n";
+	for (size_t i = 0; i < 3; ++i) {
+		result += "\t"s + random.pick(types) + " " + random.pick(identifiers) + std::to_string(i) + ";\n";
+	}
+	result += "\tint get(int y) {\n\t\treturn " + expression(random, 3) + ";\n\t}\n";
+	return result + "}\n\n";
+}
+
+// many small functions and classes
+static std::string wide(size_t size) {
+	generator random(1);
+	std::string result = "namespace bench::wide;\n\n";
+	for (size_t i = 0; result.size() < size; ++i) {
+		result += i % 8 == 7 ? classdef(random, i) : function(random, i, 1 + random.below(6));
+	}
+	return result;
+}
+
+// a few functions whose expressions nest hundreds of levels deep
+static std::string deep(size_t size) {
+	generator random(2);
+	std::string result = "namespace bench::deep;\n\n";
+	for (size_t i = 0; result.size() < size; ++i) {
+		result += "int f" + std::to_string(i) + "() {\n";
+		for (size_t j = 0; j < 8; ++j) {
+			result += "\tx = " + nested(random, 100 + random.below(400)) + ";\n";
+		}
+		result += "}\n\n";
+	}
+	return result;
+}
+
+// declarations whose types are long template instantiations, at the top level and in bodies
+static std::string templates(size_t size) {
+	generator random(3);
+	std::string result = "namespace bench::templates;\n\n";
+	for (size_t i = 0; result.size() < size; ++i) {
+		if (i % 4 == 0) {
+			result += "alias t" + std::to_string(i) + " = " + templated(random, 2 + random.below(4)) + ";\n";
+		}
+		else if (i % 4 == 1) {
+			result += templated(random, 2 + random.below(4)) + " v" + std::to_string(i) + ";\n";
+		}
+		else {
+			result += templated(random, 1 + random.below(3)) + " f" + std::to_string(i) + "("
+				+ templated(random, 2) + " a) {\n";
+			for (size_t j = random.below(4); j > 0; --j) {
+				result += "\t" + templated(random, 1 + random.below(4)) + " " + name(random) + " = a;\n";
+			}
+			result += "\treturn a;\n}\n";
+		}
+	}
+	return result;
+}
+
+// the same kind of code as wide, with more comment than code
+static std::string comments(size_t size) {
+	generator random(4);
+	std::string result = "namespace bench::comments;\n\n";
+	for (size_t i = 0; result.size() < size; ++i) {
+		result += "/*\n * f" + std::to_string(i) + " works out";
+		for (size_t j = random.below(6); j > 0; --j) {
+			result += " the " + name(random) + " of every " + name(random) + " in " + name(random) + "\n *";
+		}
+		result += "/\n// " + expression(random, 6) + "\n";
+		std::string body = function(random, i, 1 + random.below(4));
+		for (size_t line = body.find(";\n"); line != std::string::npos; line = body.find(";\n", line + 1)) {
+			std::string comment = " // " + expression(random, 2);
+			body.insert(line + 1, comment);
+			line += comment.size();
+		}
+		result += body;
+	}
+	return result;
+}
+
+using duration = std::chrono::duration<double>;
+
+struct statistics {
+	double min;
+	double median;
+	double max;
+};
+
+static statistics measure(size_t repetitions, const std::function<duration()>& run) {
+	std::vector<double> times;
+	for (size_t i = 0; i < repetitions; ++i) {
+		times.push_back(run().count());
+	}
+	std::sort(times.begin(), times.end());
+	return { times.front(), times[times.size() / 2], times.back() };
+}
+
+static std::string rate(double count, statistics time, const char* unit) {
+	std::ostringstream result;
+	result << std::fixed << std::setprecision(1) << count / time.median << " " << unit << " ("
+		<< count / time.max << "-" << count / time.min << ")";
+	return result.str();
+}
+
+static std::string milliseconds(statistics time) {
+	std::ostringstream result;
+	result << std::fixed << std::setprecision(2) << time.median * 1e3 << " ms (" << time.min * 1e3
+		<< "-" << time.max * 1e3 << ")";
+	return result.str();
+}
+
+int main(int argc, char** argv) {
+	size_t repetitions = 7;
+	size_t size = 1 << 20;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--repetitions") {
+			repetitions = std::max(atoi(argv[i + 1]), 1);
+		}
+		else if (arg == "--size") {
+			size = (size_t)(atof(argv[i + 1]) * (1 << 20));
+		}
+	}
+
+	std::vector<std::pair<const char*, std::string>> corpora = {
+		{ "wide", wide(size) },
+		{ "deep", deep(size) },
+		{ "templates", templates(size) },
+		{ "comments", comments(size) },
+	};
+	std::cout << "median of " << repetitions << " runs, with the range in parentheses" << std::endl;
+	for (auto& corpus : corpora) {
+		const std::string& source = corpus.second;
+		size_t tokens = 0, nodes = 0, diagnostics = 0;
+		{
+			std::vector<origin::diagnostic> found;
+			origin::interner names;
+			origin::lexer lex(source, found, names);
+			while (lex.next().type != origin::token_type::eof) {
+				tokens++;
+			}
+		}
+		statistics lexing = measure(repetitions, [&] {
+			std::vector<origin::diagnostic> found;
+			origin::interner names;
+			origin::lexer lex(source, found, names);
+			auto start = std::chrono::steady_clock::now();
+			lex.tokenize();
+			return duration(std::chrono::steady_clock::now() - start);
+		});
+		statistics parsing = measure(repetitions, [&] {
+			std::vector<origin::diagnostic> found;
+			origin::interner names;
+			origin::lexer lex(source, found, names);
+			origin::parser parser(lex, found);
+			lex.tokenize();
+			auto start = std::chrono::steady_clock::now();
+			parser.read_program();
+			duration time = std::chrono::steady_clock::now() - start;
+			nodes = parser.allocations();
+			diagnostics = found.size();
+			return time;
+		});
+		// the same, but into one arena that's reset between runs, as a resident process would
+		origin::allocator resident;
+		statistics warm = measure(repetitions, [&] {
+			resident.reset();
+			std::vector<origin::diagnostic> found;
+			origin::interner names;
+			origin::lexer lex(source, found, names);
+			origin::parser parser(lex, found, resident);
+			lex.tokenize();
+			auto start = std::chrono::steady_clock::now();
+			parser.read_program();
+			return duration(std::chrono::steady_clock::now() - start);
+		});
+		// a space put in or taken out again after the first line, so that every declaration
+		// after it is taken over by the reparse, a character further on or back
+		std::vector<origin::diagnostic> reported;
+		origin::interner kept_names;
+		origin::lexer kept_lex(source, reported, kept_names);
+		origin::parser reparser(kept_lex, reported);
+		kept_lex.tokenize();
+		origin::program* program = reparser.read_program();
+		size_t at = source.find('\n') + 1;
+		bool spaced = false;
+		statistics reparsing = measure(repetitions, [&] {
+			reported.clear();
+			auto start = std::chrono::steady_clock::now();
+			program = spaced ? reparser.reparse(program, at, 1, "") : reparser.reparse(program, at, 0, " ");
+			duration time = std::chrono::steady_clock::now() - start;
+			spaced = !spaced;
+			return time;
+		});
+		double megabytes = source.size() / 1e6;
+		std::cout << corpus.first << ": " << std::fixed << std::setprecision(2) << megabytes << " MB, "
+			<< tokens << " tokens, " << nodes << " nodes, " << diagnostics << " diagnostics" << std::endl;
+		std::cout << "  lexer:  " << rate(megabytes, lexing, "MB/s") << ", "
+			<< rate(tokens / 1e6, lexing, "M tokens/s") << std::endl;
+		std::cout << "  parser: " << rate(megabytes, parsing, "MB/s") << ", "
+			<< rate(tokens / 1e6, parsing, "M tokens/s") << ", " << rate(nodes / 1e6, parsing, "M nodes/s")
+			<< std::endl;
+		std::cout << "  warm:   " << rate(megabytes, warm, "MB/s") << ", "
+			<< rate(tokens / 1e6, warm, "M tokens/s") << ", " << rate(nodes / 1e6, warm, "M nodes/s")
+			<< std::endl;
+		std::cout << "  reparse after an edit at the top: " << milliseconds(reparsing) << ", against "
+			<< milliseconds(parsing) << " for the whole" << std::endl;
+	}
+
+	// a streamed program is let go of as it's lexed, so what the lexer holds on to should stay
+	// about the same however long it is, but for its line table, at a byte or two a line
+	std::cout << "streaming, what the lexer holds besides its window:" << std::endl;
+	for (size_t copies : { 1, 4, 16 }) {
+		std::string source;
+		for (size_t i = 0; i < copies; ++i) {
+			source += corpora[0].second;
+		}
+		std::istringstream input(source);
+		std::vector<origin::diagnostic> found;
+		origin::interner names;
+		origin::lexer lex(input, found, names, 1 << 16);
+		while (lex.next().type != origin::token_type::eof);
+		std::cout << "  " << corpora[0].first << " x" << copies << ": " << std::fixed << std::setprecision(2)
+			<< source.size() / 1e6 << " MB, " << std::count(source.begin(), source.end(), '\n') << " lines, "
+			<< std::setprecision(1) << lex.footprint() / 1e3 << " KB, window " << lex.source().size() / 1e3
+			<< " KB" << std::endl;
+	}
+}
\ No newline at end of file
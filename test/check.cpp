@@ -0,0 +1,862 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "flat_ast.h"
+#include "flat_file.h"
+#include "lexer.h"
+#include "parser.h"
+#include "source_manager.h"
+#include "type_analysis.h"
+
+// checks that the faster paths through the front end give exactly what the plain ones do, and
+// that the trees and diagnostics of the programs it's given are still the ones kept under
+// --golden; --update writes them out afresh instead, and it exits with 1 if anything differs
+
+using namespace std::string_literals;
+
+// xorshift, so that the variants made are the same on every run and platform
+class generator {
+private:
+	uint64_t state;
+public:
+	generator(uint64_t seed) : state(seed) {}
+
+	size_t below(size_t n) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return (size_t)(state % n);
+	}
+};
+
+static std::string read_file(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	std::ostringstream contents;
+	contents << in.rdbuf();
+	return contents.str();
+}
+
+// every token as next() gives it, with its atom, spelling and the newline before it, then the
+// lexer's diagnostics
+static std::string tokens_of(origin::lexer& lex, const std::vector<origin::diagnostic>& diagnostics,
+	bool atoms = true) {
+	std::ostringstream out;
+	while (true) {
+		origin::token token = lex.next();
+		out << (int)token.type << " " << (int)token.kind << " ";
+		if (atoms) out << token.value << " ";
+		out << "'" << lex.names.get(token.value) << "' " << token.start << "-" << token.end;
+		if (lex.has_newline()) {
+			out << " after " << lex.newline_token().start;
+		}
+		out << "\n";
+		if (token.type == origin::token_type::eof) break;
+	}
+	for (const origin::diagnostic& d : diagnostics) {
+		out << "! " << d.message << " " << d.range.loc << "+" << d.range.length << "\n";
+	}
+	return out.str();
+}
+
+// a range by the offsets it's at now, which are its locations in a program read whole
+static std::string where(origin::lexer& lex, origin::source_range range) {
+	if (!origin::is_set(range)) return "-";
+	size_t start = lex.offset_at(range.loc);
+	return std::to_string(start) + "-" + std::to_string((origin::source_loc)(start + range.length - 1));
+}
+
+// a tree as indented text, one node to a line, with the ranges of everything in it
+class dumper {
+private:
+	std::ostringstream out;
+	const origin::interner& names;
+	origin::lexer& lex;
+	size_t depth = 0;
+
+	std::ostream& line() {
+		if (out.tellp() > 0) out << "\n";
+		return out << std::string(depth * 2, ' ');
+	}
+
+	void typing(const char* role, origin::typing* typing) {
+		if (typing == nullptr) return;
+		line() << role << " " << typing->name << (typing->alias ? " alias " + typing->alias_name : ""s)
+			<< " " << where(lex, typing->range) << " generic "
+			<< (typing->generic_loc == origin::no_loc ? 0 : lex.offset_at(typing->generic_loc));
+		depth++;
+		for (origin::typing* templ : typing->templates) {
+			this->typing("template", templ);
+		}
+		depth--;
+	}
+
+	void expr(origin::expr* expr) {
+		if (expr == nullptr) {
+			line() << "null";
+			return;
+		}
+		std::ostream& out = line();
+		if (dynamic_cast<origin::error_expr*>(expr)) {
+			out << "error";
+		}
+		else if (auto x = dynamic_cast<origin::lambda*>(expr)) {
+			out << "lambda";
+		}
+		else if (auto x = dynamic_cast<origin::parenthetical*>(expr)) {
+			out << "parenthetical";
+		}
+		else if (auto x = dynamic_cast<origin::int_literal*>(expr)) {
+			out << "int " << names.get(x->value);
+		}
+		else if (auto x = dynamic_cast<origin::variable*>(expr)) {
+			out << "variable " << names.get(x->name);
+		}
+		else if (auto x = dynamic_cast<origin::member*>(expr)) {
+			out << "member " << names.get(x->name) << " at " << where(lex, x->name_range);
+		}
+		else if (auto x = dynamic_cast<origin::subscript*>(expr)) {
+			out << "subscript";
+		}
+		else if (auto x = dynamic_cast<origin::call_expr*>(expr)) {
+			out << "call";
+		}
+		else if (auto x = dynamic_cast<origin::bin_expr*>(expr)) {
+			out << "binary " << x->op << " at " << where(lex, x->op_range);
+		}
+		else if (auto x = dynamic_cast<origin::un_expr*>(expr)) {
+			out << "unary " << x->op;
+		}
+		out << " " << where(lex, expr->range);
+		depth++;
+		typing("type", expr->typing);
+		if (auto x = dynamic_cast<origin::lambda*>(expr)) {
+			typing("returns", x->return_type);
+			for (size_t i = 0; i < x->param_types.size(); ++i) {
+				typing(names.get(x->param_names[i]).c_str(), x->param_types[i]);
+			}
+			stat(x->body());
+		}
+		else if (auto x = dynamic_cast<origin::parenthetical*>(expr)) {
+			this->expr(x->expr);
+		}
+		else if (auto x = dynamic_cast<origin::member*>(expr)) {
+			this->expr(x->object);
+		}
+		else if (auto x = dynamic_cast<origin::subscript*>(expr)) {
+			this->expr(x->left);
+			this->expr(x->right);
+		}
+		else if (auto x = dynamic_cast<origin::call_expr*>(expr)) {
+			this->expr(x->function);
+			for (origin::expr* arg : x->args) {
+				this->expr(arg);
+			}
+		}
+		else if (auto x = dynamic_cast<origin::bin_expr*>(expr)) {
+			this->expr(x->left);
+			this->expr(x->right);
+		}
+		else if (auto x = dynamic_cast<origin::un_expr*>(expr)) {
+			this->expr(x->expr);
+		}
+		depth--;
+	}
+
+	void stat(origin::stat* stat) {
+		if (stat == nullptr) {
+			line() << "null";
+			return;
+		}
+		std::ostream& out = line();
+		if (auto x = dynamic_cast<origin::vardecl*>(stat)) {
+			out << "vardecl " << names.get(x->variable) << " at " << where(lex, x->var_range);
+		}
+		else if (auto x = dynamic_cast<origin::expr_stat*>(stat)) {
+			out << "expression";
+		}
+		else if (auto x = dynamic_cast<origin::if_stat*>(stat)) {
+			out << "if";
+		}
+		else if (auto x = dynamic_cast<origin::block*>(stat)) {
+			out << "block";
+		}
+		else if (auto x = dynamic_cast<origin::return_stat*>(stat)) {
+			out << "return";
+		}
+		out << " " << where(lex, stat->range);
+		depth++;
+		if (auto x = dynamic_cast<origin::vardecl*>(stat)) {
+			typing("type", x->typing);
+			if (x->init_value != nullptr) expr(x->init_value);
+		}
+		else if (auto x = dynamic_cast<origin::expr_stat*>(stat)) {
+			expr(x->expr);
+		}
+		else if (auto x = dynamic_cast<origin::if_stat*>(stat)) {
+			expr(x->cond);
+			this->stat(x->body);
+			if (x->else_body != nullptr) this->stat(x->else_body);
+		}
+		else if (auto x = dynamic_cast<origin::block*>(stat)) {
+			for (origin::stat* inner : x->stats) {
+				this->stat(inner);
+			}
+		}
+		else if (auto x = dynamic_cast<origin::return_stat*>(stat)) {
+			if (x->expr != nullptr) expr(x->expr);
+		}
+		depth--;
+	}
+public:
+	dumper(const origin::interner& names, origin::lexer& lex) : names(names), lex(lex) {}
+
+	std::string dump(origin::program* program) {
+		line() << "namespace " << program->namespace_name;
+		for (origin::variable* import : program->imports) {
+			line() << "import " << names.get(import->name) << " " << where(lex, import->range);
+		}
+		std::map<std::string, origin::typing*> typedefs(program->typedefs.begin(), program->typedefs.end());
+		for (auto& entry : typedefs) {
+			line() << "alias " << entry.first;
+			depth++;
+			typing("type", entry.second);
+			depth--;
+		}
+		for (origin::classdef* classdef : program->classes) {
+			std::ostream& out = line() << (classdef->is_struct ? "struct " : "class ")
+				<< names.get(classdef->name) << " at " << where(lex, classdef->name_range);
+			for (const std::string& generic : classdef->generics) {
+				out << " " << generic;
+			}
+			if (classdef->variadic) out << "...";
+			depth++;
+			for (size_t i = 0; i < classdef->vardecls.size(); ++i) {
+				line() << (classdef->accesses[i] == origin::public_access ? "public" : "private");
+				depth++;
+				stat(classdef->vardecls[i]);
+				depth--;
+			}
+			depth--;
+		}
+		for (origin::vardecl* vardecl : program->vardecls) {
+			stat(vardecl);
+		}
+		return out.str();
+	}
+};
+
+static void dump_diagnostics(std::ostream& out, origin::lexer& lex,
+	const std::vector<origin::diagnostic>& diagnostics) {
+	for (const origin::diagnostic& d : diagnostics) {
+		out << (d.warning ? "warning " : "error ") << where(lex, d.range) << ": " << d.message;
+		if (!d.template_str.empty()) out << " in " << d.template_str;
+		out << "\n";
+	}
+}
+
+// a program's tree and what parsing it reported, then what checking it along with
+// stdlib::core reported
+static std::string golden_dump(const std::string& source, const std::string* core) {
+	std::ostringstream out;
+	std::vector<origin::diagnostic> diagnostics;
+	origin::interner names;
+	origin::lexer lex(source, diagnostics, names);
+	origin::parser parser(lex, diagnostics);
+	lex.tokenize();
+	origin::compilation_unit unit = { parser.read_program() };
+	out << dumper(names, lex).dump(unit[0]) << "\nparsing:\n";
+	dump_diagnostics(out, lex, diagnostics);
+	diagnostics.clear();
+
+	std::vector<origin::diagnostic> core_diagnostics;
+	origin::lexer core_lex(core != nullptr ? std::string_view(*core) : std::string_view(), core_diagnostics, names);
+	origin::parser core_parser(core_lex, core_diagnostics);
+	if (core != nullptr) {
+		unit.push_back(core_parser.read_program());
+	}
+	origin::type_assigner assigner(diagnostics, names);
+	assigner.walk(&unit);
+	out << "checking:\n";
+	dump_diagnostics(out, lex, diagnostics);
+	return out.str();
+}
+
+// the file under golden with the program's name, and .txt in place of its extension
+static std::string golden_path(const std::string& golden, const std::string& program) {
+	size_t slash = program.find_last_of("/\\");
+	std::string name = program.substr(slash == std::string::npos ? 0 : slash + 1);
+	return golden + "/" + name.substr(0, name.find_last_of('.')) + ".txt";
+}
+
+static bool check_golden(const std::vector<std::pair<std::string, std::string>>& programs,
+	const std::string& golden, bool update) {
+	const std::string* core = nullptr;
+	for (auto& program : programs) {
+		if (program.second.rfind("namespace stdlib::core;", 0) == 0) core = &program.second;
+	}
+	size_t failed = 0;
+	for (auto& program : programs) {
+		std::string path = golden_path(golden, program.first);
+		std::string dump = golden_dump(program.second, &program.second == core ? nullptr : core);
+		if (update) {
+			std::ofstream(path, std::ios::binary) << dump;
+		}
+		else if (read_file(path) != dump) {
+			failed++;
+			std::cout << "  " << program.first << " no longer gives " << path << std::endl;
+		}
+	}
+	std::cout << "golden trees: " << programs.size() << " programs, "
+		<< (update ? "written"s : std::to_string(failed) + " different") << std::endl;
+	return failed == 0;
+}
+
+// a dump with each line's indentation given as a depth instead, and only its first and last
+// lines and a hash of the rest once it's long, so that trees thousands deep stay small
+static std::string summarized(const std::string& dump) {
+	std::vector<std::string> lines;
+	std::istringstream in(dump);
+	for (std::string line; std::getline(in, line);) {
+		size_t indent = line.find_first_not_of(' ');
+		if (indent == std::string::npos) indent = line.size();
+		lines.push_back(std::to_string(indent / 2) + "| " + line.substr(indent));
+	}
+	std::ostringstream out;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (lines.size() > 40 && i == 10) {
+			out << "... " << lines.size() - 20 << " lines hashing to " << std::hex
+				<< origin::hash_source(dump) << std::dec << "\n";
+			i = lines.size() - 10;
+		}
+		out << lines[i] << "\n";
+	}
+	return out.str();
+}
+
+// what parsing each operator case reported and the tree it gave: expressions nested thousands
+// deep, which the parser reads with a stack of its own rather than by recursing, and chains of
+// operators missing operands, brackets or both
+static std::string operator_dump() {
+	static const char* malformed[] = {
+		"1 + * 2", "1 +", "+ + +", "1 2 3", "(1 + 2", "1 + (2 * 3))", "a . . b", "f(1,, 2)", "x[1 +]",
+		"-", "1 << << 2", "a = = b", "f(1, 2,)", "((1 +) * 2)", "a[(1]", ") + 1", "-(-(-(", "!~-",
+		"a(b[c(d[", "1 + 2 * 3 -", "(((1)))) + ((2)",
+	};
+	std::vector<std::pair<std::string, std::string>> cases;
+	const size_t deep = 5000;
+	std::string parens, unary, mixed, unclosed;
+	for (size_t i = 0; i < deep; ++i) {
+		parens += "(";
+		unary += "-~!"[i % 3];
+		mixed += i % 2 == 0 ? "a * -(" : "~b[";
+		unclosed += "(-";
+	}
+	parens += "1" + std::string(deep, ')');
+	unary += "1";
+	mixed += "1";
+	for (size_t i = deep; i > 0; --i) {
+		mixed += (i - 1) % 2 == 0 ? ")" : "]";
+	}
+	unclosed += "1";
+	cases.emplace_back(std::to_string(deep) + " nested parentheses", parens);
+	cases.emplace_back(std::to_string(deep) + " unary operators", unary);
+	cases.emplace_back(std::to_string(deep) + " nested operators and brackets", mixed);
+	cases.emplace_back(std::to_string(deep) + " unclosed parentheses", unclosed);
+	for (const char* chain : malformed) {
+		cases.emplace_back(chain, chain);
+	}
+	std::ostringstream out;
+	for (auto& entry : cases) {
+		std::string source = "namespace operators;\nint x = " + entry.second + ";\nint y = 1;\n";
+		std::vector<origin::diagnostic> diagnostics;
+		origin::interner names;
+		origin::lexer lex(source, diagnostics, names);
+		origin::parser parser(lex, diagnostics);
+		lex.tokenize();
+		origin::program* program = parser.read_program();
+		std::ostringstream parsed;
+		dump_diagnostics(parsed, lex, diagnostics);
+		parsed << dumper(names, lex).dump(program) << "\n";
+		out << "== " << entry.first << "\n" << summarized(parsed.str());
+	}
+	return out.str();
+}
+
+static bool check_operators(const std::string& golden, bool update) {
+	std::string path = golden + "/operators.txt";
+	std::string dump = operator_dump();
+	bool same = update || read_file(path) == dump;
+	if (update) {
+		std::ofstream(path, std::ios::binary) << dump;
+	}
+	else if (!same) {
+		std::cout << "  the operator cases no longer give " << path << std::endl;
+	}
+	std::cout << "operator stack: " << (update ? "written"s : same ? "same"s : "different"s) << std::endl;
+	return same;
+}
+
+static std::string serial_tokens(const std::string& source, bool atoms = true) {
+	std::vector<origin::diagnostic> diagnostics;
+	origin::interner names;
+	origin::lexer lex(source, diagnostics, names);
+	lex.tokenize();
+	return tokens_of(lex, diagnostics, atoms);
+}
+
+static std::string parallel_tokens(const std::string& source, size_t threads, size_t chunk_size) {
+	std::vector<origin::diagnostic> diagnostics;
+	origin::interner names;
+	origin::lexer lex(source, diagnostics, names);
+	lex.tokenize(threads, chunk_size);
+	return tokens_of(lex, diagnostics);
+}
+
+// the program with comment openers and closers, newlines and quotes put in at random, so that
+// chunks start inside comments and strings, and comments are left open
+static std::string mutated(const std::string& source, generator& random) {
+	static const char* inserts[] = { "/*", "*/", "//", "\n", "\"", "/* x\n", "\n*/\n" };
+	std::string result = source;
+	for (size_t i = 1 + random.below(6); i > 0; --i) {
+		result.insert(random.below(result.size() + 1), inserts[random.below(sizeof(inserts) / sizeof(*inserts))]);
+	}
+	return result;
+}
+
+// block comments that run across many lines and hold what looks like code, line comments and
+// strings holding comment openers, and closers with no opener, so that chunk boundaries fall
+// inside and around all of them
+static std::string straddling(size_t size) {
+	generator random(5);
+	std::string result = "namespace check::comments;\n";
+	for (size_t i = 0; result.size() < size; ++i) {
+		std::string n = std::to_string(i);
+		switch (random.below(4)) {
+		case 0:
+			result += "/* int a" + n + " = 1;\n";
+			for (size_t j = random.below(8); j > 0; --j) {
+				result += "   b" + n + " = \"*\" + c; // /*\n";
+			}
+			result += "*/ int d" + n + " = 2;\n";
+			break;
+		case 1:
+			result += "int e" + n + " = f(\"/*\", 3); // */ g;\n";
+			break;
+		case 2:
+			result += "*/ h" + n + ";\n/**/ int k" + n + " = 4 /* ; */ * 5;\n";
+			break;
+		default:
+			result += "int m" + n + "() {\n\treturn n / 2 /*/ 3 */;\n}\n";
+			break;
+		}
+	}
+	return result;
+}
+
+// looks up every spelling, near misses of each keyword, and every string of up to four symbol
+// characters, which takes in each symbol's prefixes, against a plain scan of the spellings
+static bool check_kinds() {
+	static const char symbol_chars[] = ".[]()~!-+*/%<>&^|?:=,;{}";
+	static const char changes[] = "aeiouxz_1";
+	size_t lookups = 0, failed = 0;
+	auto check = [&](const std::string& text) {
+		origin::token_kind expected = origin::token_kind::none;
+		for (size_t i = 1; i < origin::token_kind_count; ++i) {
+			if (text == origin::spelling((origin::token_kind)i)) expected = (origin::token_kind)i;
+		}
+		lookups++;
+		origin::token_kind found = origin::lookup_kind(text);
+		if (found != expected && failed++ < 10) {
+			std::cout << "  '" << text << "' is looked up as '" << origin::spelling(found) << "' rather than '"
+				<< origin::spelling(expected) << "'" << std::endl;
+		}
+	};
+	for (size_t i = 0; i < origin::token_kind_count; ++i) {
+		std::string word = origin::spelling((origin::token_kind)i);
+		check(word);
+		if (word.empty() || !isalpha((unsigned char)word[0])) continue;
+		for (size_t j = 0; j < word.size(); ++j) {
+			check(word.substr(0, j));
+			check(word.substr(0, j) + word.substr(j + 1));
+			std::string upper = word;
+			upper[j] = (char)toupper((unsigned char)upper[j]);
+			check(upper);
+			for (const char* c = changes; *c != 0; ++c) {
+				std::string changed = word;
+				changed[j] = *c;
+				check(changed);
+			}
+			if (j + 1 < word.size()) {
+				std::string swapped = word;
+				std::swap(swapped[j], swapped[j + 1]);
+				check(swapped);
+			}
+		}
+		for (const char* c = changes; *c != 0; ++c) {
+			check(word + *c);
+			check(*c + word);
+		}
+		for (size_t j = 1; j < origin::token_kind_count; ++j) {
+			check(word + origin::spelling((origin::token_kind)j));
+		}
+	}
+	// every string of one to four symbol characters, each built from one a character shorter
+	std::vector<std::string> symbols = { "" };
+	for (size_t i = 0; i < symbols.size() && symbols[i].size() < 4; ++i) {
+		for (const char* c = symbol_chars; *c != 0; ++c) {
+			symbols.push_back(symbols[i] + *c);
+			check(symbols.back());
+		}
+	}
+	std::cout << "kind lookup: " << lookups << " lookups, " << failed << " different" << std::endl;
+	return failed == 0;
+}
+
+// the lexer's vector paths for skipping whitespace and block comments against its plain ones,
+// on buffers up to three 32-byte chunks long with where they stop at every offset, so that the
+// stop, or a "*" and "/" split across two lanes, falls on every 16- and 32-byte boundary and
+// within a chunk of the end of the buffer
+static bool check_skipping() {
+	generator random(5);
+	size_t cases = 0, failed = 0;
+	auto differs = [&](const std::string& text, bool comment) {
+		const char* begin = text.data();
+		const char* end = begin + text.size();
+		const char* newlines[2] = {};
+		const char* ends[2];
+		for (bool plain : { false, true }) {
+			ends[plain] = comment ? origin::block_comment_end(begin, end, plain)
+				: origin::whitespace_end(begin, end, newlines[plain], plain);
+		}
+		cases++;
+		if (ends[0] == ends[1] && newlines[0] == newlines[1]) return;
+		if (failed++ < 10) {
+			auto at = [&](const char* p) { return p == nullptr ? -1 : p - begin; };
+			std::cout << "  " << (comment ? "a block comment" : "whitespace") << " of " << text.size()
+				<< " characters ends at " << at(ends[0]) << ", first newline " << at(newlines[0])
+				<< ", rather than " << at(ends[1]) << ", " << at(newlines[1]) << std::endl;
+		}
+	};
+	for (size_t size = 0; size <= 96; ++size) {
+		for (size_t stop = 0; stop <= size; ++stop) {
+			std::string text(size, 'x');
+			for (size_t i = 0; i < stop; ++i) {
+				text[i] = " \t\r\n"[random.below(4)];
+			}
+			differs(text, false);
+		}
+		// stray '*'s and '/'s before the close, and none at all when close is size
+		for (size_t close = 0; close <= size; ++close) {
+			std::string text(size, 'a');
+			for (size_t i = 0; i < close; ++i) {
+				text[i] = "a*/\n"[random.below(4)];
+				if (i > 0 && text[i - 1] == '*' && text[i] == '/') text[i] = 'a';
+			}
+			if (close + 1 < size) {
+				text[close] = '*';
+				text[close + 1] = '/';
+			}
+			else if (close < size) {
+				text[close] = '*';
+			}
+			differs(text, true);
+		}
+	}
+	std::cout << "vector skipping: " << cases << " cases, " << failed << " different" << std::endl;
+	return failed == 0;
+}
+
+// lexes each source serially and in parallel, with chunks small enough to split every token
+// and big enough to hold many lines
+static bool check_lexing(const std::vector<std::pair<std::string, std::string>>& sources) {
+	static const size_t chunk_sizes[] = { 1, 2, 7, 16, 64, 300, 4096 };
+	size_t runs = 0, failed = 0;
+	for (auto& source : sources) {
+		std::string expected = serial_tokens(source.second);
+		for (size_t threads = 2; threads <= 4; ++threads) {
+			for (size_t chunk_size : chunk_sizes) {
+				if (chunk_size < 16 && source.second.size() > (1 << 16)) continue;
+				runs++;
+				if (parallel_tokens(source.second, threads, chunk_size) != expected) {
+					if (failed++ < 10) {
+						std::cout << "  " << source.first << " lexes differently on " << threads
+							<< " threads in chunks of " << chunk_size << std::endl;
+					}
+				}
+			}
+		}
+	}
+	std::cout << "parallel lexing: " << sources.size() << " sources, " << runs << " runs, "
+		<< failed << " different" << std::endl;
+	return failed == 0;
+}
+
+// where each token starts, as a line and column, then the start of the first line of each of
+// the first few hundred diagnostics, as much as a streaming lexer has room to keep
+static std::string lines_of(origin::lexer& lex, const std::vector<origin::diagnostic>& diagnostics) {
+	std::ostringstream out;
+	while (true) {
+		origin::token token = lex.next();
+		out << lex.line_of(token.start) << ":" << lex.column_of(token.start) << "\n";
+		if (token.type == origin::token_type::eof) break;
+	}
+	for (size_t i = 0; i < std::min(diagnostics.size(), (size_t)300); ++i) {
+		size_t line = lex.line_of(diagnostics[i].range.loc);
+		out << "! " << line << " " << lex.line(line).substr(0, 256) << "\n";
+	}
+	return out.str();
+}
+
+static std::string streamed(const std::string& source, size_t block_size, bool lines) {
+	std::istringstream input(source);
+	std::vector<origin::diagnostic> diagnostics;
+	origin::interner names;
+	origin::lexer lex(input, diagnostics, names, block_size);
+	return lines ? lines_of(lex, diagnostics) : tokens_of(lex, diagnostics);
+}
+
+// streams each source in blocks of a few sizes, against lexing it whole, for its tokens and
+// then for the lines they're found on and the lines kept for diagnostics
+static bool check_streaming(const std::vector<std::pair<std::string, std::string>>& sources) {
+	static const size_t block_sizes[] = { 1, 16, 300, 1 << 16 };
+	size_t runs = 0, failed = 0;
+	for (auto& source : sources) {
+		std::vector<origin::diagnostic> diagnostics;
+		origin::interner names;
+		origin::lexer lex(source.second, diagnostics, names);
+		std::string expected[] = { serial_tokens(source.second), lines_of(lex, diagnostics) };
+		for (size_t block_size : block_sizes) {
+			if (block_size < 300 && source.second.size() > (1 << 16)) continue;
+			for (bool lines : { false, true }) {
+				runs++;
+				if (streamed(source.second, block_size, lines) != expected[lines]) {
+					if (failed++ < 10) {
+						std::cout << "  " << source.first << " streams differently in blocks of " << block_size
+							<< (lines ? ", by line" : "") << std::endl;
+					}
+				}
+			}
+		}
+	}
+	std::cout << "streamed lexing: " << sources.size() << " sources, " << runs << " runs, "
+		<< failed << " different" << std::endl;
+	return failed == 0;
+}
+
+// relexes each source after edits of a few characters at random, against lexing what the
+// edits leave from scratch; atoms aren't compared, since edits intern in a different order
+static bool check_editing(const std::vector<std::pair<std::string, std::string>>& sources) {
+	static const char alphabet[] = "{}();,=+ \n\n/*ab1<>.:\"#~";
+	generator random(2);
+	size_t edits = 0, failed = 0;
+	for (auto& source : sources) {
+		if (source.second.size() > (1 << 16)) continue;
+		std::vector<origin::diagnostic> diagnostics;
+		origin::interner names;
+		origin::lexer lex(source.second, diagnostics, names);
+		lex.tokenize();
+		for (size_t i = 0; i < 20; ++i) {
+			std::string_view text = lex.source();
+			size_t offset = random.below(text.size() + 1);
+			size_t removed = std::min(random.below(6), text.size() - offset);
+			std::string inserted;
+			for (size_t j = random.below(5); j > 0; --j) {
+				inserted += alphabet[random.below(sizeof(alphabet) - 1)];
+			}
+			diagnostics.clear();
+			lex.edit(offset, removed, inserted);
+			edits++;
+			std::string expected = serial_tokens(std::string(lex.source()), false);
+			if (tokens_of(lex, diagnostics, false) != expected) {
+				if (failed++ < 10) {
+					std::cout << "  " << source.first << " lexes differently after edit " << i << std::endl;
+				}
+				break;
+			}
+		}
+	}
+	std::cout << "incremental lexing: " << edits << " edits, " << failed << " different" << std::endl;
+	return failed == 0;
+}
+
+// what reading a program reported, then its tree, by offset
+static std::string parsed(origin::lexer& lex, origin::program* program,
+	const std::vector<origin::diagnostic>& diagnostics) {
+	std::ostringstream out;
+	dump_diagnostics(out, lex, diagnostics);
+	out << dumper(lex.names, lex).dump(program);
+	return out.str();
+}
+
+static std::string fresh_parse(const std::string& source, bool lazy) {
+	std::vector<origin::diagnostic> diagnostics;
+	origin::interner names;
+	origin::lexer lex(source, diagnostics, names);
+	origin::parser parser(lex, diagnostics);
+	parser.lazy_bodies = lazy;
+	lex.tokenize();
+	origin::program* program = parser.read_program();
+	std::vector<origin::diagnostic> reported = diagnostics;
+	return parsed(lex, program, reported);
+}
+
+// reads each source again after edits at random, a few characters or a copy of some of the
+// text, with and without lazy bodies, against reading what the edits leave from scratch; what
+// parsing reported is taken before the trees are dumped, since that reads the lazy bodies; the
+// sources are placed after another file, with room for edits that soon runs out
+static bool check_reparsing(const std::vector<std::pair<std::string, std::string>>& sources) {
+	static const char alphabet[] = "{}();,=+ \n\n/*ab1<>.:";
+	generator random(3);
+	size_t edits = 0, failed = 0;
+	for (auto& source : sources) {
+		if (source.second.size() > (1 << 16)) continue;
+		for (bool lazy : { false, true }) {
+			std::vector<origin::diagnostic> diagnostics;
+			origin::interner names;
+			origin::lexer lex(source.second, diagnostics, names);
+			origin::lexer before("namespace before;", diagnostics, names);
+			origin::source_manager files;
+			files.add("before", before);
+			files.add(source.first, lex, true);
+			origin::parser parser(lex, diagnostics);
+			parser.lazy_bodies = lazy;
+			lex.tokenize();
+			origin::program* program = parser.read_program();
+			for (size_t i = 0; i < 10; ++i) {
+				std::string text(lex.source());
+				size_t offset = random.below(text.size() + 1);
+				size_t removed = std::min(random.below(6), text.size() - offset);
+				std::string inserted;
+				if (random.below(2) == 0) {
+					inserted = text.substr(random.below(text.size() + 1), random.below(30));
+				}
+				else {
+					for (size_t j = random.below(5); j > 0; --j) {
+						inserted += alphabet[random.below(sizeof(alphabet) - 1)];
+					}
+				}
+				diagnostics.clear();
+				program = parser.reparse(program, offset, removed, inserted);
+				edits++;
+				std::vector<origin::diagnostic> reported = diagnostics;
+				if (parsed(lex, program, reported) != fresh_parse(std::string(lex.source()), lazy)) {
+					if (failed++ < 10) {
+						std::cout << "  " << source.first << " reads differently after edit " << i
+							<< (lazy ? " with lazy bodies" : "") << std::endl;
+					}
+					break;
+				}
+			}
+		}
+	}
+	std::cout << "reparsing: " << edits << " edits, " << failed << " different" << std::endl;
+	return failed == 0;
+}
+
+// writes each program's flat file and reads it back, against the tree it was written from;
+// then reads copies of the file with a bit flipped here and there, which must either be turned
+// away or inflate and flatten again without going astray
+static bool check_flat_files(const std::vector<std::pair<std::string, std::string>>& programs) {
+	static const std::string path = "origin-check.flat";
+	generator random(4);
+	size_t damaged = 0, turned_away = 0, failed = 0;
+	for (auto& program : programs) {
+		std::vector<origin::diagnostic> diagnostics;
+		origin::interner names;
+		origin::lexer lex(program.second, diagnostics, names);
+		origin::source_manager files;
+		origin::source_loc base = files.add(program.first, lex);
+		origin::parser parser(lex, diagnostics);
+		lex.tokenize();
+		origin::program* parsed = parser.read_program();
+		origin::flat_tree tree;
+		origin::flattener(names, tree).walk(parsed);
+		origin::write_flat_file(path, tree, lex.source());
+		std::string contents = read_file(path);
+		{
+			origin::mapped_flat_file file(path, lex.source());
+			origin::allocator memory;
+			if (!file.valid() || dumper(names, lex).dump(origin::inflate(file.view(), memory, names, base))
+				!= dumper(names, lex).dump(parsed)) {
+				failed++;
+				std::cout << "  " << program.first << " reads back differently from its flat file" << std::endl;
+			}
+		}
+		for (size_t i = 0; i < 300; ++i) {
+			std::string copy = contents;
+			copy[random.below(copy.size())] ^= (char)(1 << random.below(8));
+			std::ofstream(path, std::ios::binary) << copy;
+			origin::mapped_flat_file file(path, lex.source());
+			damaged++;
+			if (!file.valid()) {
+				turned_away++;
+				continue;
+			}
+			origin::allocator memory;
+			origin::flat_tree again;
+			origin::flattener(names, again).walk(origin::inflate(file.view(), memory, names, base));
+		}
+	}
+	remove(path.c_str());
+	std::cout << "flat files: " << programs.size() << " programs, " << failed << " different, "
+		<< damaged << " damaged copies, " << turned_away << " turned away" << std::endl;
+	return failed == 0;
+}
+
+int main(int argc, char** argv) {
+	std::string golden;
+	bool update = false;
+	std::vector<std::pair<std::string, std::string>> programs;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--golden" && i + 1 < argc) {
+			golden = argv[++i];
+		}
+		else if (arg == "--update") {
+			update = true;
+		}
+		else {
+			programs.emplace_back(arg, read_file(arg));
+		}
+	}
+
+	if (!golden.empty()) {
+		bool ok = check_golden(programs, golden, update);
+		ok = check_operators(golden, update) && ok;
+		if (update || !ok) return ok ? 0 : 1;
+	}
+
+	std::vector<std::pair<std::string, std::string>> sources = programs;
+	generator random(1);
+	for (auto& program : programs) {
+		for (size_t i = 0; i < 40; ++i) {
+			sources.emplace_back(program.first + " variant " + std::to_string(i), mutated(program.second, random));
+		}
+	}
+	sources.emplace_back("straddling comments", straddling(1 << 14));
+	sources.emplace_back("large straddling comments", straddling(3 << 20));
+
+	bool ok = check_kinds();
+	ok = check_skipping() && ok;
+	ok = check_flat_files(programs) && ok;
+	ok = check_lexing(sources) && ok;
+	ok = check_editing(sources) && ok;
+	ok = check_reparsing(sources) && ok;
+	// every variant one after another, long enough that the lines of most diagnostics are only
+	// kept as snippets once they're streamed past
+	std::string variants;
+	for (size_t i = programs.size(); i < sources.size() - 2; ++i) {
+		variants += sources[i].second + "\n";
+	}
+	sources.emplace_back("every variant", variants);
+	ok = check_streaming(sources) && ok;
+	return ok ? 0 : 1;
+}
\ No newline at end of file